@@ -8,4 +8,13 @@
 #include "../src/compiler.h"
 #include "../src/memory.h"
 
+// Natives call back into Lox with vmCall(callee, argCount, args, &result).
+// When it returns false a runtime error has been reported and the native
+// should return right away.
+
+// takeString() still adopts a buffer from ALLOCATE(char, length + 1), but
+// strings store their characters inline, so it copies and frees it. Writing
+// into allocateString(length)->chars skips the copy, and copyString() suits
+// buffers the module keeps.
+
 #endif
\ No newline at end of file
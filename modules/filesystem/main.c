@@ -46,22 +46,14 @@ static Value readFileText(Value *receiver, int argCount, Value *args) {
   fseek(file, 0, SEEK_END);
   size_t size = ftell(file);
   rewind(file);
-  char *buffer = ALLOCATE(char, size + 1);
-  if(buffer == NULL) {
-    // runtimeError("Could not allocate memory for file \"%s\"", path->chars);
-    fclose(file);
-    return NIL_VAL;
-  }
-  size_t read = fread(buffer, sizeof(char), size, file);
+  ObjString *text = allocateString(size);
+  size_t read = fread(text->chars, sizeof(char), size, file);
+  fclose(file);
   if(read < size) {
     // runtimeError("Could not read file \"%s\"", path->chars);
-    FREE(size +1, buffer);
-    fclose(file);
     return NIL_VAL;
   }
-  buffer[size] = '\0';
-  fclose(file);
-  return OBJ_VAL(takeString(buffer, size));
+  return OBJ_VAL(text);
 }
 
 static Value writeFileText(Value *receiver, int argCount, Value *args) {
@@ -199,7 +191,7 @@ static Value listDirectory(Value *receiver, int argCount, Value *args) {
     tableSet(&obj->fields, typeKey, OBJ_VAL(type));
     pop();
 
-    writeValueArray(&list->values, peek(0));
+    writeArray(list, peek(0));
 
     pop();
   }
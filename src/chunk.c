@@ -1,9 +1,14 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "chunk.h"
 #include "memory.h"
 #include "vm.h"
 
+static size_t chunkSize(int capacity) {
+  return (sizeof(int) + sizeof(uint8_t)) * capacity;
+}
+
 void initChunk(Chunk* chunk) {
   chunk->count = 0;
   chunk->capacity = 0;
@@ -14,12 +19,20 @@ void initChunk(Chunk* chunk) {
 
 void writeChunk(Chunk* chunk, uint8_t byte, int line) {
   if (chunk->capacity < chunk->count + 1) {
+    // The lines and the code share one allocation, so running out of memory
+    // can't leave one array grown and the other not
     int oldCapacity = chunk->capacity;
-    chunk->capacity = GROW_CAPACITY(oldCapacity);
-    chunk->code = GROW_ARRAY(uint8_t, chunk->code,
-        oldCapacity, chunk->capacity);
-    chunk->lines = GROW_ARRAY(int, chunk->lines,
-        oldCapacity, chunk->capacity);
+    int capacity = GROW_CAPACITY(oldCapacity);
+    int* lines = (int*)ALLOCATE(uint8_t, chunkSize(capacity));
+    uint8_t* code = (uint8_t*)(lines + capacity);
+    if (chunk->count > 0) {
+      memcpy(lines, chunk->lines, sizeof(int) * chunk->count);
+      memcpy(code, chunk->code, sizeof(uint8_t) * chunk->count);
+    }
+    FREE_ARRAY(uint8_t, chunk->lines, chunkSize(oldCapacity));
+    chunk->lines = lines;
+    chunk->code = code;
+    chunk->capacity = capacity;
   }
 
   chunk->code[chunk->count] = byte;
@@ -28,8 +41,7 @@ void writeChunk(Chunk* chunk, uint8_t byte, int line) {
 }
 
 void freeChunk(Chunk* chunk) {
-  FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
-  FREE_ARRAY(int, chunk->lines, chunk->capacity);
+  FREE_ARRAY(uint8_t, chunk->lines, chunkSize(chunk->capacity));
   freeValueArray(&chunk->constants);
   initChunk(chunk);
 }
@@ -43,6 +43,10 @@ typedef enum {
   OP_CLASS,
   OP_INHERIT,
   OP_METHOD,
+  OP_GET_INDEX,
+  OP_SET_INDEX,
+  OP_ARRAY_LITERAL,
+  OP_OBJECT_LITERAL,
 } OpCode;
 
 typedef struct {
@@ -12,11 +12,9 @@
 // #define DEBUG_STRESS_GC
 // #define DEBUG_LOG_GC
 
-#define UINT8_COUNT (UINT8_MAX + 1)
+// Compares every formatted number against the shortest "%.*e" that reads back
+// #define DEBUG_CHECK_NUMBERS
 
-// Need to save as much memory as possible on low mem system
-#ifdef PICO_MODULE
-#define DEBUG_STRESS_GC
-#endif
+#define UINT8_COUNT (UINT8_MAX + 1)
 
 #endif
@@ -5,6 +5,7 @@
 #include "common.h"
 #include "compiler.h"
 #include "memory.h"
+#include "number.h"
 #include "scanner.h"
 
 #ifdef DEBUG_PRINT_CODE
@@ -451,24 +452,43 @@ static void dot(bool canAssign) {
   }
 }
 
+static void index_(bool canAssign) {
+  expression();
+  consume(TOKEN_RIGHT_BRACKET, "Expect ']' after index.");
+
+  if (canAssign && match(TOKEN_EQUAL)) {
+    expression();
+    emitByte(OP_SET_INDEX);
+  } else {
+    emitByte(OP_GET_INDEX);
+  }
+}
+
+// The field values are left on the stack and OP_OBJECT_LITERAL is
+// followed by the name constant of each one, so the instance is built
+// with its fields sized once
 static void dotObj(bool canAssign) {
   consume(TOKEN_LEFT_BRACE, "Expect '{' after '.' for object literal.");
 
   Token objectToken = syntheticToken("Object");
   objectToken.type = TOKEN_IDENTIFIER;
 
-  // Construct an object
   uint8_t objectClass = identifierConstant(&objectToken);
   emitBytes(OP_GET_GLOBAL, objectClass);
-  emitBytes(OP_CALL, 0);
 
+  uint8_t names[UINT8_COUNT];
+  int fieldCount = 0;
   while(!check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF)) {
     consume(TOKEN_IDENTIFIER, "Expect field name for object.");
     uint8_t name = identifierConstant(&parser.previous);
 
     consume(TOKEN_COLON, "Expect ':' after field name.");
     expression();
-    emitBytes(OP_SET_PROPERTY_SHADOWED, name);
+    if (fieldCount == 255) {
+      error("Can't have more than 255 fields in an object literal.");
+    } else {
+      names[fieldCount++] = name;
+    }
 
     if(!match(TOKEN_COMMA) && !check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF)) {
       errorAtCurrent("Expected ',' or '}' in object literal.");
@@ -477,6 +497,30 @@ static void dotObj(bool canAssign) {
   }
 
   consume(TOKEN_RIGHT_BRACE, "Expect '}' to close object literal.");
+
+  emitBytes(OP_OBJECT_LITERAL, (uint8_t)fieldCount);
+  for (int i = 0; i < fieldCount; i++) {
+    emitByte(names[i]);
+  }
+}
+
+static void arrayLiteral(bool canAssign) {
+  int count = 0;
+  while (!check(TOKEN_RIGHT_BRACKET) && !check(TOKEN_EOF)) {
+    expression();
+    if (count == 255) {
+      error("Can't have more than 255 elements in an array literal.");
+    }
+    count++;
+
+    if (!match(TOKEN_COMMA) && !check(TOKEN_RIGHT_BRACKET) && !check(TOKEN_EOF)) {
+      errorAtCurrent("Expected ',' or ']' in array literal.");
+      break;
+    }
+  }
+
+  consume(TOKEN_RIGHT_BRACKET, "Expect ']' to close array literal.");
+  emitBytes(OP_ARRAY_LITERAL, (uint8_t)count);
 }
 
 static void literal(bool canAssign) {
@@ -494,7 +538,7 @@ static void grouping(bool canAssign) {
 }
 
 static void number(bool canAssign) {
-  double value = strtod(parser.previous.start, NULL);
+  double value = parseNumber(parser.previous.start, parser.previous.length);
   emitConstant(NUMBER_VAL(value));
 }
 
@@ -601,6 +645,8 @@ ParseRule rules[] = {
   [TOKEN_RIGHT_PAREN]   = {NULL,     NULL,   PREC_NONE},
   [TOKEN_LEFT_BRACE]    = {NULL,     NULL,   PREC_NONE}, 
   [TOKEN_RIGHT_BRACE]   = {NULL,     NULL,   PREC_NONE},
+  [TOKEN_LEFT_BRACKET]  = {arrayLiteral, index_, PREC_CALL},
+  [TOKEN_RIGHT_BRACKET] = {NULL,     NULL,   PREC_NONE},
   [TOKEN_COMMA]         = {NULL,     NULL,   PREC_NONE},
   [TOKEN_DOT]           = {dotObj,   dot,    PREC_CALL},
   [TOKEN_MINUS]         = {unary,    binary, PREC_TERM},
@@ -964,13 +1010,24 @@ static void statement() {
   }
 }
 
-ObjFunction* compile(const char* source) {
-  initScanner(source);
-  Compiler compiler;
-  initCompiler(&compiler, TYPE_SCRIPT);
+// The compilers live in C stack frames, which are gone once a compilation
+// is abandoned part way through because the heap ran out.
+void resetCompiler() {
+  current = NULL;
+  currentClass = NULL;
+}
 
+static void initParser(const char* source) {
+  initScanner(source);
+  resetCompiler();
   parser.hadError = false;
   parser.panicMode = false;
+}
+
+ObjFunction* compile(const char* source) {
+  initParser(source);
+  Compiler compiler;
+  initCompiler(&compiler, TYPE_SCRIPT);
 
   advance();
 
@@ -983,14 +1040,11 @@ ObjFunction* compile(const char* source) {
 }
 
 ObjFunction* compileEval(const char* source) {
-  initScanner(source);
+  initParser(source);
   Compiler compiler;
   initCompiler(&compiler, TYPE_SCRIPT);
   beginScope();
 
-  parser.hadError = false;
-  parser.panicMode = false;
-
   advance();
 
   while (!match(TOKEN_EOF)) {
@@ -1002,7 +1056,7 @@ ObjFunction* compileEval(const char* source) {
 }
 
 ObjFunction* compileModule(const char* source) {
-  initScanner(source);
+  initParser(source);
   Compiler compiler;
   initCompiler(&compiler, TYPE_MODULE);
   beginScope();
@@ -1013,9 +1067,6 @@ ObjFunction* compileModule(const char* source) {
   addLocal(moduleToken);
   markInitialized();
 
-  parser.hadError = false;
-  parser.panicMode = false;
-
   advance();
 
   while (!match(TOKEN_EOF)) {
@@ -8,5 +8,6 @@ ObjFunction* compile(const char* source);
 ObjFunction* compileModule(const char* source);
 ObjFunction* compileEval(const char* source);
 void markCompilerRoots();
+void resetCompiler();
 
 #endif
@@ -25,6 +25,19 @@ static int jumpInstruction(const char* name, int sign,
   return offset + 3;
 }
 
+static int objectLiteralInstruction(const char* name, Chunk* chunk,
+                                    int offset) {
+  uint8_t fieldCount = chunk->code[offset + 1];
+  printf("%-16s %4d", name, fieldCount);
+  for (int i = 0; i < fieldCount; i++) {
+    printf(" '");
+    printValue(chunk->constants.values[chunk->code[offset + 2 + i]]);
+    printf("'");
+  }
+  printf("\n");
+  return offset + 2 + fieldCount;
+}
+
 static int constantInstruction(const char* name, Chunk* chunk,
                                int offset) {
   uint8_t constant = chunk->code[offset + 1];
@@ -156,6 +169,14 @@ int disassembleInstruction(Chunk* chunk, int offset) {
       return simpleInstruction("OP_INHERIT", offset);
     case OP_METHOD:
       return constantInstruction("OP_METHOD", chunk, offset);
+    case OP_GET_INDEX:
+      return simpleInstruction("OP_GET_INDEX", offset);
+    case OP_SET_INDEX:
+      return simpleInstruction("OP_SET_INDEX", offset);
+    case OP_ARRAY_LITERAL:
+      return byteInstruction("OP_ARRAY_LITERAL", chunk, offset);
+    case OP_OBJECT_LITERAL:
+      return objectLiteralInstruction("OP_OBJECT_LITERAL", chunk, offset);
     default:
       printf("Unknown opcode %d\n", instruction);
       return offset + 1;
@@ -11,6 +11,7 @@
 #include "common.h"
 #include "chunk.h"
 #include "debug.h"
+#include "memory.h"
 #include "vm.h"
 
 #include "stdlib_lox.h"
@@ -97,6 +98,34 @@ static void runFile(const char* path, bool validateOnly) {
   if (result == INTERPRET_RUNTIME_ERROR) runtime_exit(70);
 }
 
+// Strips --gc-<option>=<value> flags out of argv, returns the remaining count
+static int parseGCFlags(int argc, const char* argv[]) {
+  int remaining = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--gc-", 5) != 0) {
+      argv[remaining++] = argv[i];
+      continue;
+    }
+
+    char name[64];
+    const char* option = argv[i] + 5;
+    const char* value = strchr(option, '=');
+    size_t nameLength = value == NULL ? 0 : (size_t)(value - option);
+    if (value == NULL || nameLength >= sizeof(name)) {
+      fprintf(stderr, "Expected --gc-<option>=<value> but got \"%s\".\n", argv[i]);
+      exit(64);
+    }
+    memcpy(name, option, nameLength);
+    name[nameLength] = '\0';
+
+    if (!setGCOption(name, value + 1)) {
+      fprintf(stderr, "Invalid GC option \"%s\".\n", argv[i]);
+      exit(64);
+    }
+  }
+  return remaining;
+}
+
 static void setupStdLib() {
   runBytes(stdlib_lib_lox, stdlib_lib_lox_len);
 }
@@ -121,6 +150,7 @@ int main(int argc, const char* argv[]) {
   setupStdLib();
   pico_repl();
   #else
+  argc = parseGCFlags(argc, argv);
   if (argc == 1) {
     setupStdLib();
     repl();
@@ -132,7 +162,7 @@ int main(int argc, const char* argv[]) {
     runFile(argv[2], true);
     fprintf(stdout, "%s is valid\n", argv[2]);
   } else {
-    fprintf(stderr, "Usage: clox [path]\n");
+    fprintf(stderr, "Usage: clox [--gc-<option>=<value>...] [path]\n");
     exit(64);
   }
   #endif
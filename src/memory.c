@@ -1,26 +1,242 @@
+#ifdef __linux__
+#define _GNU_SOURCE // mremap
+#endif
+
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "compiler.h"
 #include "memory.h"
 #include "vm.h"
 
 #ifdef DEBUG_LOG_GC
-#include <stdio.h>
 #include "debug.h"
 #endif
 
+#ifdef PICO_MODULE
+#include <pico/stdlib.h>
+#else
+#include <time.h>
+#endif
+
+#if !defined(WASM) && !defined(PICO_MODULE)
+#define LARGE_SPACE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef GC_PARALLEL_MARK
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #define GC_HEAP_GROW_FACTOR 2
+// Allocation headroom between collections in low memory mode
+#define GC_LOW_MEMORY_HEADROOM 1024
+// Objects swept per allocation while a lazy sweep is pending
+#define GC_SWEEP_STEP 256
+#define GC_PARALLEL_MARK_THRESHOLD (64 * 1024 * 1024)
+#define GC_MAX_MARK_THREADS 16
+// A marker keeps at least this many gray objects before sharing the rest
+#define GC_MARK_SHARE_MIN 32
+
+#ifdef PICO_MODULE
+#define GC_INITIAL_HEAP_SIZE 1024
+#define GC_MIN_EXTERNAL_BUDGET (4 * 1024)
+#else
+#define GC_INITIAL_HEAP_SIZE (1024 * 1024)
+#define GC_MIN_EXTERNAL_BUDGET (16 * 1024 * 1024)
+#endif
+
+// Upper bound (exclusive) of each pause histogram bucket, the last one is open ended
+static const uint64_t gcPauseBucketLimitsNs[GC_PAUSE_BUCKETS] = {
+  100000, 500000, 1000000, 5000000, 10000000, 50000000, 100000000, UINT64_MAX
+};
+
+static const char* gcPauseBucketNames[GC_PAUSE_BUCKETS] = {
+  "<0.1ms", "<0.5ms", "<1ms", "<5ms", "<10ms", "<50ms", "<100ms", ">=100ms"
+};
+
+static uint64_t gcNowNs() {
+#ifdef PICO_MODULE
+  return to_us_since_boot(get_absolute_time()) * 1000;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static bool parseBool(const char* value, bool* result) {
+  if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+    *result = true;
+    return true;
+  }
+  if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+    *result = false;
+    return true;
+  }
+  return false;
+}
+
+// Accepts plain byte counts or a K/M/G suffix, e.g. "64M"
+static bool parseSize(const char* value, size_t* size) {
+  char* end;
+  double parsed = strtod(value, &end);
+  if (end == value || parsed < 0) return false;
+  switch (*end) {
+    case 'k': case 'K': parsed *= 1024; end++; break;
+    case 'm': case 'M': parsed *= 1024 * 1024; end++; break;
+    case 'g': case 'G': parsed *= 1024.0 * 1024 * 1024; end++; break;
+    default: break;
+  }
+  if (*end != '\0') return false;
+  // Also rejects NaN, which would make the cast undefined
+  if (!(parsed < (double)SIZE_MAX)) return false;
+  *size = (size_t)parsed;
+  return true;
+}
+
+bool setGCOption(const char* name, const char* value) {
+  if (strcmp(name, "grow-factor") == 0) {
+    char* end;
+    double factor = strtod(value, &end);
+    if (end == value || *end != '\0' || factor < 1.0) return false;
+    vm.gcConfig.heapGrowFactor = factor;
+    return true;
+  }
+  if (strcmp(name, "initial-heap") == 0) {
+    size_t size;
+    if (!parseSize(value, &size)) return false;
+    vm.gcConfig.initialHeapSize = size;
+    // Only meaningful before the first collection has set its own threshold
+    if (vm.gcStats.collections == 0) vm.nextGC = size;
+    return true;
+  }
+  if (strcmp(name, "heap-limit") == 0) {
+    size_t size;
+    if (!parseSize(value, &size)) return false;
+    vm.gcConfig.heapLimit = size;
+    return true;
+  }
+  if (strcmp(name, "low-memory") == 0) {
+    return parseBool(value, &vm.gcConfig.lowMemory);
+  }
+  if (strcmp(name, "lazy-sweep") == 0) {
+    return parseBool(value, &vm.gcConfig.lazySweep);
+  }
+  if (strcmp(name, "mark-threads") == 0) {
+    char* end;
+    long threads = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || threads < 0 ||
+        threads > GC_MAX_MARK_THREADS) return false;
+    vm.gcConfig.markThreads = (int)threads;
+    return true;
+  }
+  if (strcmp(name, "parallel-mark-threshold") == 0) {
+    return parseSize(value, &vm.gcConfig.parallelMarkThreshold);
+  }
+  return false;
+}
 
+const char* gcPauseBucketName(int bucket) {
+  return gcPauseBucketNames[bucket];
+}
+
+void initGC() {
+  vm.bytesAllocated = 0;
+  vm.externalBytes = 0;
+  vm.nextExternalGC = GC_MIN_EXTERNAL_BUDGET;
+  vm.debug_maxTotalAllocated = 0;
+  memset(&vm.gcStats, 0, sizeof(GCStats));
+
+  vm.gcConfig.heapGrowFactor = GC_HEAP_GROW_FACTOR;
+  vm.gcConfig.initialHeapSize = GC_INITIAL_HEAP_SIZE;
+  vm.gcConfig.heapLimit = 0;
+#ifdef PICO_MODULE
+  vm.gcConfig.lowMemory = true;
+#else
+  vm.gcConfig.lowMemory = false;
+#endif
+  vm.gcConfig.lazySweep = true;
+  vm.gcConfig.markThreads = 0;
+  vm.gcConfig.parallelMarkThreshold = GC_PARALLEL_MARK_THRESHOLD;
+  vm.outOfMemoryJump = NULL;
+  vm.sweepLink = NULL;
+  vm.nextGC = vm.gcConfig.initialHeapSize;
+
+  static const char* envOptions[][2] = {
+    {"CLOX_GC_GROW_FACTOR", "grow-factor"},
+    {"CLOX_GC_INITIAL_HEAP", "initial-heap"},
+    {"CLOX_GC_HEAP_LIMIT", "heap-limit"},
+    {"CLOX_GC_LOW_MEMORY", "low-memory"},
+    {"CLOX_GC_LAZY_SWEEP", "lazy-sweep"},
+    {"CLOX_GC_MARK_THREADS", "mark-threads"},
+    {"CLOX_GC_PARALLEL_MARK_THRESHOLD", "parallel-mark-threshold"},
+  };
+  for (size_t i = 0; i < sizeof(envOptions) / sizeof(envOptions[0]); i++) {
+    const char* value = getenv(envOptions[i][0]);
+    if (value != NULL && !setGCOption(envOptions[i][1], value)) {
+      fprintf(stderr, "Ignoring invalid %s value \"%s\".\n",
+              envOptions[i][0], value);
+    }
+  }
+}
+
+static bool heapLimitExceeded() {
+  return vm.gcConfig.heapLimit != 0 &&
+         vm.bytesAllocated + vm.externalBytes > vm.gcConfig.heapLimit;
+}
+
+static bool collectionDue() {
+  return vm.bytesAllocated > vm.nextGC ||
+         vm.externalBytes > vm.nextExternalGC;
+}
+
+static void startCollection(bool lazy);
+static void sweepObjects(size_t budget);
+
+// Unwinds to the running interpret() call, which reports a runtime error
+static void outOfMemory() {
+  if (vm.outOfMemoryJump == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+  longjmp(*vm.outOfMemoryJump, 1);
+}
 
 void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
   vm.bytesAllocated += newSize - oldSize;
   if (newSize > oldSize) {
+    vm.gcStats.allocations++;
+    bool collected = false;
 #ifdef DEBUG_STRESS_GC
     collectGarbage();
+    collected = true;
 #endif
 
-    if (vm.bytesAllocated > vm.nextGC) {
-      collectGarbage();
+    if (!collected && vm.sweepLink != NULL) {
+      uint64_t start = gcNowNs();
+      sweepObjects(GC_SWEEP_STEP);
+      vm.gcStats.lazySweepNs += gcNowNs() - start;
+    }
+
+    if (!collected && collectionDue()) {
+      // Finishing a pending sweep may free enough to put off the collection
+      if (vm.sweepLink != NULL) sweepObjects(SIZE_MAX);
+      if (collectionDue()) startCollection(true);
+      collected = true;
+    }
+
+    if (heapLimitExceeded()) {
+      // Emergency collection before giving up on the allocation
+      finishSweep();
+      if (heapLimitExceeded() && !collected) collectGarbage();
+      if (heapLimitExceeded()) {
+        vm.bytesAllocated -= newSize - oldSize;
+        outOfMemory();
+      }
     }
 
     if(vm.bytesAllocated > vm.debug_maxTotalAllocated) {
@@ -34,12 +250,145 @@ void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
   }
 
   void* result = realloc(pointer, newSize);
-  if (result == NULL) exit(1);
+  if (result == NULL) {
+    collectGarbage();
+    result = realloc(pointer, newSize);
+    if (result == NULL) {
+      vm.bytesAllocated -= newSize - oldSize;
+      outOfMemory();
+    }
+  }
+  return result;
+}
+
+#ifdef LARGE_SPACE_MMAP
+static size_t pageRound(size_t size) {
+  static size_t pageSize = 0;
+  if (pageSize == 0) pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  return (size + pageSize - 1) & ~(pageSize - 1);
+}
+#endif
+
+static void* mapLarge(void* pointer, size_t oldSize, size_t newSize) {
+#ifdef LARGE_SPACE_MMAP
+  size_t oldMapped = pageRound(oldSize);
+  size_t newMapped = pageRound(newSize);
+  if (pointer != NULL && oldMapped == newMapped) return pointer;
+
+  void* result;
+  if (pointer == NULL) {
+    result = mmap(NULL, newMapped, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else {
+#ifdef __linux__
+    // Lets the kernel move the pages instead of copying the contents
+    result = mremap(pointer, oldMapped, newMapped, MREMAP_MAYMOVE);
+#else
+    result = mmap(NULL, newMapped, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (result != MAP_FAILED) {
+      memcpy(result, pointer, oldSize < newSize ? oldSize : newSize);
+      munmap(pointer, oldMapped);
+    }
+#endif
+  }
+  return result == MAP_FAILED ? NULL : result;
+#else
+  return realloc(pointer, newSize);
+#endif
+}
+
+void* reallocateLarge(void* pointer, size_t oldSize, size_t newSize) {
+  vm.externalBytes += newSize - oldSize;
+  if (newSize > oldSize) {
+    bool collected = false;
+    if (collectionDue()) {
+      collectGarbage();
+      collected = true;
+    }
+
+    if (heapLimitExceeded()) {
+      if (!collected) collectGarbage();
+      if (heapLimitExceeded()) {
+        vm.externalBytes -= newSize - oldSize;
+        outOfMemory();
+      }
+    }
+  }
+
+  if (newSize == 0) {
+#ifdef LARGE_SPACE_MMAP
+    munmap(pointer, pageRound(oldSize));
+#else
+    free(pointer);
+#endif
+    return NULL;
+  }
+
+  void* result = mapLarge(pointer, oldSize, newSize);
+  if (result == NULL) {
+    collectGarbage();
+    result = mapLarge(pointer, oldSize, newSize);
+    if (result == NULL) {
+      vm.externalBytes -= newSize - oldSize;
+      outOfMemory();
+    }
+  }
   return result;
 }
 
+void setRefExternalSize(ObjRef* ref, size_t size) {
+  vm.externalBytes += size - ref->externalSize;
+  ref->externalSize = size;
+}
+
+#ifdef GC_PARALLEL_MARK
+typedef struct {
+  int index;
+  pthread_t thread;
+
+  // Only touched by the owning thread
+  Obj** stack;
+  int count;
+  int capacity;
+
+  // Work handed out to idle markers, guarded by lock
+  pthread_mutex_t lock;
+  Obj** shared;
+  int sharedCount;
+  int sharedCapacity;
+} MarkWorker;
+
+static MarkWorker markWorkers[GC_MAX_MARK_THREADS];
+static int markWorkerCount;
+static int idleMarkWorkers;
+// Set on the marking threads while a parallel mark is running
+static _Thread_local MarkWorker* currentMarker = NULL;
+
+static void growMarkStack(Obj*** stack, int* capacity, int needed) {
+  if (*capacity >= needed) return;
+  while (*capacity < needed) *capacity = GROW_CAPACITY(*capacity);
+  *stack = (Obj**)realloc(*stack, sizeof(Obj*) * *capacity);
+  if (*stack == NULL) exit(1);
+}
+
+static void markerPush(MarkWorker* worker, Obj* object) {
+  growMarkStack(&worker->stack, &worker->capacity, worker->count + 1);
+  worker->stack[worker->count++] = object;
+}
+#endif
+
 void markObject(Obj* object) {
   if (object == NULL) return;
+#ifdef GC_PARALLEL_MARK
+  if (currentMarker != NULL) {
+    // Whichever marker flips the bit first owns tracing the object
+    if (__atomic_load_n(&object->isMarked, __ATOMIC_RELAXED)) return;
+    if (__atomic_exchange_n(&object->isMarked, true, __ATOMIC_RELAXED)) return;
+    markerPush(currentMarker, object);
+    return;
+  }
+#endif
   if (object->isMarked) return;
 
 #ifdef DEBUG_LOG_GC
@@ -123,10 +472,27 @@ static void blackenObject(Obj* object) {
       markValue(bound->receiver);
       break;
     }
+    case OBJ_STRING: {
+      ObjString* string = (ObjString*)object;
+      if (string->isSlice) {
+        markObject((Obj*)SLICE_PARENT(string));
+      } else if (string->chars == NULL) {
+        markObject((Obj*)ROPE_PARTS(string)->left);
+        markObject((Obj*)ROPE_PARTS(string)->right);
+      }
+      break;
+    }
     case OBJ_BUFFER:
     case OBJ_REF:
     case OBJ_NATIVE:
-    case OBJ_STRING:
+    case OBJ_STRING_BUILDER:
+    case OBJ_TYPED_ARRAY:
+      break;
+    case OBJ_MAP:
+      markValueTable(&((ObjMap*)object)->table);
+      break;
+    case OBJ_SET:
+      markValueTable(&((ObjSet*)object)->table);
       break;
   }
 }
@@ -182,8 +548,19 @@ static void freeObject(Obj* object) {
     }
     case OBJ_STRING: {
       ObjString* string = (ObjString*)object;
-      FREE_ARRAY(char, string->chars, string->length + 1);
-      FREE(ObjString, object);
+      if (string->isSlice) {
+        if (SLICE_PARENT(string) == NULL) {
+          FREE_ARRAY(char, string->chars, string->length + 1);
+        }
+        reallocate(object, sizeof(ObjString) + sizeof(ObjString*), 0);
+      } else if (IS_ROPE(string)) {
+        if (string->chars != NULL) {
+          FREE_ARRAY(char, string->chars, string->length + 1);
+        }
+        reallocate(object, sizeof(ObjString) + sizeof(RopeParts), 0);
+      } else {
+        reallocate(object, sizeof(ObjString) + string->length + 1, 0);
+      }
       break;
     }
     case OBJ_UPVALUE: {
@@ -192,7 +569,11 @@ static void freeObject(Obj* object) {
     }
     case OBJ_BUFFER: {
       ObjBuffer* buffer = (ObjBuffer*)object;
-      FREE_ARRAY(uint8_t, buffer->bytes, buffer->size);
+      if (buffer->isLarge) {
+        reallocateLarge(buffer->bytes, buffer->size, 0);
+      } else {
+        FREE_ARRAY(uint8_t, buffer->bytes, buffer->size);
+      }
       FREE(ObjBuffer, object);
       break;
     }
@@ -201,9 +582,40 @@ static void freeObject(Obj* object) {
       if(ref->dispose != NULL) {
         ref->dispose(ref->data);
       }
+      vm.externalBytes -= ref->externalSize;
       FREE(ObjRef, object);
       break;
     }
+    case OBJ_STRING_BUILDER: {
+      ObjStringBuilder* builder = (ObjStringBuilder*)object;
+      if (builder->isLarge) {
+        reallocateLarge(builder->chars, builder->capacity, 0);
+      } else {
+        FREE_ARRAY(char, builder->chars, builder->capacity);
+      }
+      FREE(ObjStringBuilder, object);
+      break;
+    }
+    case OBJ_TYPED_ARRAY: {
+      ObjTypedArray* array = (ObjTypedArray*)object;
+      if (array->isLarge) {
+        reallocateLarge(array->data, TYPED_ARRAY_BYTES(array), 0);
+      } else {
+        FREE_ARRAY(uint8_t, array->data, TYPED_ARRAY_BYTES(array));
+      }
+      FREE(ObjTypedArray, object);
+      break;
+    }
+    case OBJ_MAP: {
+      freeValueTable(&((ObjMap*)object)->table);
+      FREE(ObjMap, object);
+      break;
+    }
+    case OBJ_SET: {
+      freeValueTable(&((ObjSet*)object)->table);
+      FREE(ObjSet, object);
+      break;
+    }
   }
 }
 
@@ -223,60 +635,281 @@ static void markRoots() {
   }
 
   markTable(&vm.globals);
+  for (int type = 0; type < OBJ_TYPE_COUNT; type++) {
+    markTable(&vm.nativeMethods[type]);
+  }
   markCompilerRoots();
   markObject((Obj*)vm.initString);
+  for (int i = 0; i < 256; i++) {
+    markObject((Obj*)vm.charStrings[i]);
+  }
+}
+
+#ifdef GC_PARALLEL_MARK
+// Moves the upper half of the private stack where idle markers can take it
+static void shareWork(MarkWorker* worker) {
+  int half = worker->count / 2;
+  pthread_mutex_lock(&worker->lock);
+  growMarkStack(&worker->shared, &worker->sharedCapacity,
+                worker->sharedCount + half);
+  memcpy(worker->shared + worker->sharedCount,
+         worker->stack + worker->count - half, sizeof(Obj*) * half);
+  __atomic_store_n(&worker->sharedCount, worker->sharedCount + half,
+                   __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&worker->lock);
+  worker->count -= half;
+}
+
+// Takes back our own shared work first, then steals half of another's
+static bool takeWork(MarkWorker* worker) {
+  for (int i = 0; i < markWorkerCount; i++) {
+    MarkWorker* victim = &markWorkers[(worker->index + i) % markWorkerCount];
+    if (__atomic_load_n(&victim->sharedCount, __ATOMIC_ACQUIRE) == 0) continue;
+
+    pthread_mutex_lock(&victim->lock);
+    int take = victim == worker ? victim->sharedCount
+                                : (victim->sharedCount + 1) / 2;
+    if (take > 0) {
+      growMarkStack(&worker->stack, &worker->capacity, worker->count + take);
+      memcpy(worker->stack + worker->count,
+             victim->shared + victim->sharedCount - take, sizeof(Obj*) * take);
+      worker->count += take;
+      __atomic_store_n(&victim->sharedCount, victim->sharedCount - take,
+                       __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&victim->lock);
+    if (take > 0) return true;
+  }
+  return false;
 }
 
+static bool anySharedWork() {
+  for (int i = 0; i < markWorkerCount; i++) {
+    if (__atomic_load_n(&markWorkers[i].sharedCount, __ATOMIC_ACQUIRE) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Only a busy marker shares work and an idle one has always emptied its own
+// shared stack, so once every marker is idle there is nothing left to trace.
+static bool waitForWork() {
+  __atomic_add_fetch(&idleMarkWorkers, 1, __ATOMIC_ACQ_REL);
+  for (;;) {
+    if (anySharedWork()) {
+      __atomic_sub_fetch(&idleMarkWorkers, 1, __ATOMIC_ACQ_REL);
+      return true;
+    }
+    if (__atomic_load_n(&idleMarkWorkers, __ATOMIC_ACQUIRE) == markWorkerCount) {
+      return false;
+    }
+    sched_yield();
+  }
+}
+
+static void* runMarkWorker(void* arg) {
+  MarkWorker* worker = (MarkWorker*)arg;
+  currentMarker = worker;
+  do {
+    do {
+      while (worker->count > 0) {
+        blackenObject(worker->stack[--worker->count]);
+        if (worker->count > GC_MARK_SHARE_MIN &&
+            __atomic_load_n(&worker->sharedCount, __ATOMIC_RELAXED) == 0) {
+          shareWork(worker);
+        }
+      }
+    } while (takeWork(worker));
+  } while (waitForWork());
+  currentMarker = NULL;
+  return NULL;
+}
+
+static int markThreadCount() {
+  int threads = vm.gcConfig.markThreads;
+  if (threads == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cores < 1 ? 1 : (int)cores;
+  }
+  return threads > GC_MAX_MARK_THREADS ? GC_MAX_MARK_THREADS : threads;
+}
+
+// Deals the roots out to the markers and traces the heap with all of them,
+// the calling thread acting as the first marker
+static bool traceReferencesInParallel() {
+  int threads = markThreadCount();
+  if (threads < 2 || vm.grayCount < threads) return false;
+
+  markWorkerCount = threads;
+  idleMarkWorkers = 0;
+  for (int i = 0; i < threads; i++) {
+    MarkWorker* worker = &markWorkers[i];
+    worker->index = i;
+    worker->count = 0;
+    worker->sharedCount = 0;
+    pthread_mutex_init(&worker->lock, NULL);
+  }
+  for (int i = 0; i < vm.grayCount; i++) {
+    markerPush(&markWorkers[i % threads], vm.grayStack[i]);
+  }
+  vm.grayCount = 0;
+
+  int started = 1;
+  while (started < threads &&
+         pthread_create(&markWorkers[started].thread, NULL, runMarkWorker,
+                        &markWorkers[started]) == 0) {
+    started++;
+  }
+  if (started < threads) {
+    // Couldn't get every thread, the missing markers' roots go to this one
+    for (int i = started; i < threads; i++) {
+      MarkWorker* worker = &markWorkers[i];
+      for (int j = 0; j < worker->count; j++) {
+        markerPush(&markWorkers[0], worker->stack[j]);
+      }
+      worker->count = 0;
+    }
+    __atomic_store_n(&idleMarkWorkers, threads - started, __ATOMIC_RELEASE);
+  }
+
+  runMarkWorker(&markWorkers[0]);
+  for (int i = 1; i < started; i++) {
+    pthread_join(markWorkers[i].thread, NULL);
+  }
+
+  for (int i = 0; i < threads; i++) {
+    MarkWorker* worker = &markWorkers[i];
+    pthread_mutex_destroy(&worker->lock);
+    free(worker->stack);
+    free(worker->shared);
+    worker->stack = NULL;
+    worker->shared = NULL;
+    worker->capacity = 0;
+    worker->sharedCapacity = 0;
+  }
+  vm.gcStats.parallelMarks++;
+  return true;
+}
+#endif
+
 static void traceReferences() {
+#ifdef GC_PARALLEL_MARK
+  if (vm.bytesAllocated + vm.externalBytes >= vm.gcConfig.parallelMarkThreshold &&
+      traceReferencesInParallel()) {
+    return;
+  }
+#endif
   while (vm.grayCount > 0) {
     Obj* object = vm.grayStack[--vm.grayCount];
     blackenObject(object);
   }
 }
 
-static void sweep() {
-  Obj* previous = NULL;
-  Obj* object = vm.objects;
-  while (object != NULL) {
+// Sets the next collection thresholds once the heap only holds live objects
+static void finishCollection() {
+  if (vm.gcConfig.lowMemory) {
+    vm.nextGC = vm.bytesAllocated + GC_LOW_MEMORY_HEADROOM;
+    vm.nextExternalGC = vm.externalBytes + GC_LOW_MEMORY_HEADROOM;
+  } else {
+    vm.nextGC = (size_t)(vm.bytesAllocated * vm.gcConfig.heapGrowFactor);
+    // External memory gets its own budget so a few large buffers don't force
+    // a full collection every time they are touched
+    vm.nextExternalGC = (size_t)(vm.externalBytes * vm.gcConfig.heapGrowFactor);
+    if (vm.nextExternalGC < GC_MIN_EXTERNAL_BUDGET) {
+      vm.nextExternalGC = GC_MIN_EXTERNAL_BUDGET;
+    }
+  }
+
+#ifdef DEBUG_LOG_GC
+  printf("   collected %zu bytes, now at %zu next at %zu\n",
+         vm.gcStats.lastBytesFreed, vm.bytesAllocated, vm.nextGC);
+#endif
+}
+
+// Frees up to budget unmarked objects starting at vm.sweepLink. Objects
+// allocated since the collection are linked in ahead of the cursor (see
+// allocateObject()), so everything the sweep visits was traced by it.
+static void sweepObjects(size_t budget) {
+  size_t freed = 0;
+  while (*vm.sweepLink != NULL) {
+    if (budget-- == 0) break;
+    Obj* object = *vm.sweepLink;
     if (object->isMarked) {
       object->isMarked = false;
-      previous = object;
-      object = object->next;
+      vm.sweepLink = &object->next;
     } else {
-      Obj* unreached = object;
-      object = object->next;
-      if (previous != NULL) {
-        previous->next = object;
-      } else {
-        vm.objects = object;
-      }
-
-      freeObject(unreached);
+      *vm.sweepLink = object->next;
+      size_t before = vm.bytesAllocated + vm.externalBytes;
+      freeObject(object);
+      freed += before - (vm.bytesAllocated + vm.externalBytes);
     }
   }
+  vm.gcStats.lastBytesFreed += freed;
+  vm.gcStats.totalBytesFreed += freed;
+
+  if (*vm.sweepLink == NULL) {
+    vm.sweepLink = NULL;
+    finishCollection();
+  }
 }
 
-void collectGarbage() {
+void finishSweep() {
+  if (vm.sweepLink != NULL) sweepObjects(SIZE_MAX);
+}
+
+static void recordPause(uint64_t pauseNs) {
+  GCStats* stats = &vm.gcStats;
+  stats->collections++;
+  stats->lastPauseNs = pauseNs;
+  stats->totalPauseNs += pauseNs;
+  if (pauseNs > stats->maxPauseNs) stats->maxPauseNs = pauseNs;
+
+  int bucket = 0;
+  while (pauseNs >= gcPauseBucketLimitsNs[bucket]) bucket++;
+  stats->pauseHistogram[bucket]++;
+}
+
+// A lazy collection only marks, the unreached objects are then freed a few
+// at a time by later allocations instead of inside the pause
+static void startCollection(bool lazy) {
 #ifdef DEBUG_LOG_GC
   printf("-- gc begin\n");
-  size_t before = vm.bytesAllocated;
 #endif
+  // The previous cycle's mark bits have to be cleared before marking again
+  finishSweep();
+  uint64_t start = gcNowNs();
+  vm.gcStats.lastBytesFreed = 0;
 
   markRoots();
   traceReferences();
   tableRemoveWhite(&vm.strings);
-  sweep();
 
-  vm.nextGC = vm.bytesAllocated * GC_HEAP_GROW_FACTOR;
+  if (vm.gcConfig.lowMemory) {
+    // The gray stack lives outside the managed heap, release it between collections
+    free(vm.grayStack);
+    vm.grayStack = NULL;
+    vm.grayCapacity = 0;
+  }
+
+  vm.sweepLink = &vm.objects;
+  if (lazy && vm.gcConfig.lazySweep && !vm.gcConfig.lowMemory) {
+    // Bound the heap growth until the sweep catches up
+    vm.nextGC = (size_t)(vm.bytesAllocated * vm.gcConfig.heapGrowFactor);
+  } else {
+    sweepObjects(SIZE_MAX);
+  }
+  recordPause(gcNowNs() - start);
 
 #ifdef DEBUG_LOG_GC
   printf("-- gc end\n");
-  printf("   collected %zu bytes (from %zu to %zu) next at %zu\n",
-         before - vm.bytesAllocated, before, vm.bytesAllocated,
-         vm.nextGC);
 #endif
 }
 
+void collectGarbage() {
+  startCollection(false);
+}
+
 void freeObjects() {
   Obj* object = vm.objects;
   while (object != NULL) {
@@ -315,7 +948,10 @@ size_t objStructSize(Obj* object) {
       return sizeof(ObjBoundNative);
     }
     case OBJ_STRING: {
-      return sizeof(ObjString);
+      ObjString* string = (ObjString*)object;
+      if (string->isSlice) return sizeof(ObjString) + sizeof(ObjString*);
+      if (IS_ROPE(string)) return sizeof(ObjString) + sizeof(RopeParts);
+      return sizeof(ObjString) + string->length + 1;
     }
     case OBJ_UPVALUE: {
       return sizeof(ObjUpvalue);
@@ -326,6 +962,18 @@ size_t objStructSize(Obj* object) {
     case OBJ_REF: {
       return sizeof(ObjRef);
     }
+    case OBJ_STRING_BUILDER: {
+      return sizeof(ObjStringBuilder);
+    }
+    case OBJ_TYPED_ARRAY: {
+      return sizeof(ObjTypedArray);
+    }
+    case OBJ_MAP: {
+      return sizeof(ObjMap);
+    }
+    case OBJ_SET: {
+      return sizeof(ObjSet);
+    }
   }
   return 0;
 }
@@ -19,10 +19,19 @@
 #define FREE_ARRAY(type, pointer, oldCount) \
     reallocate(pointer, sizeof(type) * (oldCount), 0)
 
+// Allocations at least this big live in the large object space
+#define LARGE_OBJECT_THRESHOLD (64 * 1024)
+
 void* reallocate(void* pointer, size_t oldSize, size_t newSize);
+void* reallocateLarge(void* pointer, size_t oldSize, size_t newSize);
+void setRefExternalSize(ObjRef* ref, size_t size);
+void initGC();
+bool setGCOption(const char* name, const char* value);
+const char* gcPauseBucketName(int bucket);
 void markObject(Obj* object);
 void markValue(Value value);
 void collectGarbage();
+void finishSweep();
 void freeObjects();
 size_t objStructSize(Obj* object);
 
@@ -80,22 +80,25 @@ static void freeLoxSource() {
   }
 }
 
-static void compileAndCallLoxModule(const char *source, ObjInstance *instance) {
+static Value compileAndCallLoxModule(const char *source, ObjInstance *instance) {
   push(OBJ_VAL(instance));
   ObjFunction *function = compileModule(source);
   if(function == NULL) {
     // runtimeError("compileAndCallLoxModule() failed to compile.");
     pop();
-    return;
+    return NIL_VAL;
   }
   function->arity++; // for "module"
   push(OBJ_VAL(function));
   ObjClosure* closure = newClosure(function);
   pop();
   pop();
-  push(OBJ_VAL(closure));
-  push(OBJ_VAL(instance)); // "module" var
-  callModule(closure, 1);
+  Value module = OBJ_VAL(instance); // "module" var
+  Value result;
+  if(!vmCall(OBJ_VAL(closure), 1, &module, &result)) {
+    return NIL_VAL;
+  }
+  return result;
 }
 
 Value systemImportNative(Value *receiver, int argCount, Value *args) {
@@ -145,19 +148,15 @@ Value systemImportNative(Value *receiver, int argCount, Value *args) {
     return NIL_VAL;
   }
 
-  // Similar to callLoxCode(), we need to pop everything off for this native function first
-  for (int i = 0; i < argCount; i++) {
-    pop(); // pop the args off
-  }
-  pop(); // pop the existing native function off
-
-  if(loxSource != NULL) {
-    compileAndCallLoxModule(loxSource, moduleInstance);
-    freeLoxSource();
-  } else {
-    push(OBJ_VAL(moduleInstance)); // Same result as if we had called the Lox code
+  if(loxSource == NULL) {
+    return OBJ_VAL(moduleInstance); // Same result as if we had called the Lox code
   }
-  return NIL_VAL;
+  // Running the module may import others, which would replace loxSource
+  const char *source = loxSource;
+  loxSource = NULL;
+  Value result = compileAndCallLoxModule(source, moduleInstance);
+  free((void*)source);
+  return result;
 }
 
 void freeNativeModules() {
@@ -177,7 +176,7 @@ void registerNativeMethod(const char *name, NativeFn function) {
   ObjInstance *instance = AS_INSTANCE(peek(0));
   ObjString *methodName = copyString(name, strlen(name));
   push(OBJ_VAL(methodName));
-  push(OBJ_VAL(newNative(function, false)));
+  push(OBJ_VAL(newNative(function)));
   tableSet(&instance->klass->methods, methodName, peek(0));
   pop();
   pop();
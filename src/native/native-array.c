@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "common.h"
 #include "compiler.h"
 #include "debug.h"
@@ -7,10 +9,10 @@
 
 Value array(Value *receiver, int argCount, Value* args) {
   ObjArray *value = newArray();
-  ValueArray *arr = &value->values;
   push(OBJ_VAL(value));
+  reserveValueArray(&value->values, argCount);
   for (int i = 0; i < argCount; i++) {
-    writeValueArray(arr, args[i]);
+    writeArray(value, args[i]);
   }
   pop();
   return OBJ_VAL(value);
@@ -39,7 +41,7 @@ Value array_push(Value *receiver, int argCount, Value *args) {
     return NIL_VAL;
   }
   ObjArray *array = AS_ARRAY(*receiver);
-  writeValueArray(&array->values, args[0]);
+  writeArray(array, args[0]);
   return OBJ_VAL(array);
 }
 
@@ -81,22 +83,518 @@ Value array_get(Value *receiver, int argCount, Value *args) {
   return array->values.values[index];
 }
 
+static bool isCallable(Value value) {
+  if(!IS_OBJ(value)) {
+    return false;
+  }
+  switch(OBJ_TYPE(value)) {
+    case OBJ_BOUND_METHOD:
+    case OBJ_BOUND_NATIVE:
+    case OBJ_CLASS:
+    case OBJ_CLOSURE:
+    case OBJ_NATIVE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The callbacks may push to or pop from the array, so its count and values
+// are read again on every iteration
+
 Value array_filter(Value *receiver, int argCount, Value *args) {
-  // TODO verify args
-  return callLoxCode("_array_filter", receiver, argCount, args);
+  if (argCount != 1) {
+    // runtimeError("Expected 1 argument for 'filter' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_ARRAY(*receiver) || !isCallable(args[0])) {
+    // runtimeError("Expected a function.");
+    return NIL_VAL;
+  }
+  ObjArray *array = AS_ARRAY(*receiver);
+  ObjArray *result = newArray();
+  push(OBJ_VAL(result));
+  for (int i = 0; i < array->values.count; i++) {
+    Value element = array->values.values[i];
+    Value keep;
+    if (!vmCall(args[0], 1, &element, &keep)) {
+      return NIL_VAL;
+    }
+    if (!IS_NIL(keep) && !(IS_BOOL(keep) && !AS_BOOL(keep))) {
+      writeArray(result, element);
+    }
+  }
+  pop();
+  return OBJ_VAL(result);
 }
 
 Value array_map(Value *receiver, int argCount, Value *args) {
-  // TODO verify args
-  return callLoxCode("_array_map", receiver, argCount, args);
+  if (argCount != 1) {
+    // runtimeError("Expected 1 argument for 'map' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_ARRAY(*receiver) || !isCallable(args[0])) {
+    // runtimeError("Expected a function.");
+    return NIL_VAL;
+  }
+  ObjArray *array = AS_ARRAY(*receiver);
+  ObjArray *result = newArray();
+  push(OBJ_VAL(result));
+  reserveValueArray(&result->values, array->values.count);
+  for (int i = 0; i < array->values.count; i++) {
+    Value mapped;
+    if (!vmCall(args[0], 1, &array->values.values[i], &mapped)) {
+      return NIL_VAL;
+    }
+    writeArray(result, mapped);
+  }
+  pop();
+  return OBJ_VAL(result);
 }
 
 Value array_foreach(Value *receiver, int argCount, Value *args) {
-  // TODO verify args
-  return callLoxCode("_array_foreach", receiver, argCount, args);
+  if (argCount != 1) {
+    // runtimeError("Expected 1 argument for 'forEach' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_ARRAY(*receiver) || !isCallable(args[0])) {
+    // runtimeError("Expected a function.");
+    return NIL_VAL;
+  }
+  ObjArray *array = AS_ARRAY(*receiver);
+  for (int i = 0; i < array->values.count; i++) {
+    Value callbackArgs[2] = { array->values.values[i], NUMBER_VAL(i) };
+    Value ignored;
+    if (!vmCall(args[0], 2, callbackArgs, &ignored)) {
+      return NIL_VAL;
+    }
+  }
+  return NIL_VAL;
 }
 
 Value array_slice(Value *receiver, int argCount, Value *args) {
-  // TODO verify args
-  return callLoxCode("_array_slice", receiver, argCount, args);
+  if (argCount != 2) {
+    // runtimeError("Expected 2 arguments for 'slice' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_ARRAY(*receiver)) {
+    // runtimeError("Value is not an array.");
+    return NIL_VAL;
+  }
+  if (!IS_NUMBER(args[0]) || !IS_NUMBER(args[1])) {
+    // runtimeError("Indices must be numbers.");
+    return NIL_VAL;
+  }
+  ObjArray *array = AS_ARRAY(*receiver);
+  int start = (int)AS_NUMBER(args[0]);
+  int end = (int)AS_NUMBER(args[1]);
+  if (end > array->values.count) {
+    end = array->values.count;
+  }
+  ObjArray *result = newArray();
+  if (start < 0 || start >= end) {
+    return OBJ_VAL(result);
+  }
+  push(OBJ_VAL(result));
+  reserveValueArray(&result->values, end - start);
+  memcpy(result->values.values, array->values.values + start,
+         sizeof(Value) * (end - start));
+  result->values.count = end - start;
+  result->kind = array->kind;
+  pop();
+  return OBJ_VAL(result);
+}
+
+// Sorting. Without a comparator, arrays of only numbers sort ascending with
+// NaN last, and arrays of only strings sort by their bytes. Both orders are
+// compared in C. A comparator is called as comparator(a, b) and returns a
+// negative number when a goes first.
+
+typedef enum {
+  SORT_NUMBERS,
+  SORT_STRINGS,
+  SORT_COMPARATOR,
+} SortMode;
+
+typedef struct {
+  SortMode mode;
+  Value comparator;
+  bool vmFailed; // the VM has already reported the error and reset
+  bool badResult; // the comparator didn't return a number
+} SortContext;
+
+#define SORT_INSERTION_THRESHOLD 16
+
+static inline int compareStrings(ObjString *a, ObjString *b) {
+  int length = a->length < b->length ? a->length : b->length;
+  int result = memcmp(a->chars, b->chars, length);
+  if (result != 0) {
+    return result;
+  }
+  return a->length - b->length;
+}
+
+// Once the comparator fails every pair compares as ordered, so the sort
+// winds down without calling it again
+static inline bool sortLess(SortContext *context, Value a, Value b) {
+  switch (context->mode) {
+    case SORT_NUMBERS: {
+      double x = AS_NUMBER(a);
+      double y = AS_NUMBER(b);
+      return x < y || (y != y && x == x);
+    }
+    case SORT_STRINGS:
+      return compareStrings(AS_STRING(a), AS_STRING(b)) < 0;
+    case SORT_COMPARATOR: {
+      if (context->vmFailed || context->badResult) {
+        return false;
+      }
+      Value callbackArgs[2] = { a, b };
+      Value result;
+      if (!vmCall(context->comparator, 2, callbackArgs, &result)) {
+        context->vmFailed = true;
+        return false;
+      }
+      if (!IS_NUMBER(result)) {
+        context->badResult = true;
+        return false;
+      }
+      return AS_NUMBER(result) < 0;
+    }
+  }
+  return false;
+}
+
+static inline void swapValues(Value *items, int a, int b) {
+  Value temp = items[a];
+  items[a] = items[b];
+  items[b] = temp;
+}
+
+static void insertionSort(SortContext *context, Value *items, int count) {
+  for (int i = 1; i < count; i++) {
+    Value value = items[i];
+    int j = i;
+    while (j > 0 && sortLess(context, value, items[j - 1])) {
+      items[j] = items[j - 1];
+      j--;
+    }
+    items[j] = value;
+  }
+}
+
+static void siftDown(SortContext *context, Value *items, int root, int count) {
+  for (;;) {
+    int child = root * 2 + 1;
+    if (child >= count) {
+      return;
+    }
+    if (child + 1 < count && sortLess(context, items[child], items[child + 1])) {
+      child++;
+    }
+    if (!sortLess(context, items[root], items[child])) {
+      return;
+    }
+    swapValues(items, root, child);
+    root = child;
+  }
+}
+
+static void heapSort(SortContext *context, Value *items, int count) {
+  for (int i = count / 2 - 1; i >= 0; i--) {
+    siftDown(context, items, i, count);
+  }
+  for (int end = count - 1; end > 0; end--) {
+    swapValues(items, 0, end);
+    siftDown(context, items, 0, end);
+  }
+}
+
+// Quicksort with a median of three pivot, falling back to heapsort when the
+// partitions stay unbalanced. The scans are bounds checked so a comparator
+// that isn't a consistent order can't run them off the ends.
+static void introSort(SortContext *context, Value *items, int count, int depth) {
+  while (count > SORT_INSERTION_THRESHOLD) {
+    if (depth == 0) {
+      heapSort(context, items, count);
+      return;
+    }
+    depth--;
+
+    int mid = count / 2;
+    int last = count - 1;
+    if (sortLess(context, items[mid], items[0])) swapValues(items, mid, 0);
+    if (sortLess(context, items[last], items[mid])) {
+      swapValues(items, last, mid);
+      if (sortLess(context, items[mid], items[0])) swapValues(items, mid, 0);
+    }
+    swapValues(items, mid, 1);
+    Value pivot = items[1];
+
+    int i = 1;
+    int j = last;
+    for (;;) {
+      do i++; while (i < last && sortLess(context, items[i], pivot));
+      do j--; while (j > 1 && sortLess(context, pivot, items[j]));
+      if (i >= j) {
+        break;
+      }
+      swapValues(items, i, j);
+    }
+    swapValues(items, 1, j);
+
+    // Recurse into the smaller side to bound the stack depth
+    int leftCount = j;
+    int rightCount = count - j - 1;
+    if (leftCount < rightCount) {
+      introSort(context, items, leftCount, depth);
+      items += j + 1;
+      count = rightCount;
+    } else {
+      introSort(context, items + j + 1, rightCount, depth);
+      count = leftCount;
+    }
+  }
+  insertionSort(context, items, count);
+}
+
+// Top down merge sort, the left half is moved to scratch before merging so
+// equal elements keep their order
+static void mergeSort(SortContext *context, Value *items, Value *scratch, int count) {
+  if (count <= SORT_INSERTION_THRESHOLD) {
+    insertionSort(context, items, count);
+    return;
+  }
+  int mid = count / 2;
+  mergeSort(context, items, scratch, mid);
+  mergeSort(context, items + mid, scratch, count - mid);
+  if (!sortLess(context, items[mid], items[mid - 1])) {
+    return; // already in order
+  }
+
+  memcpy(scratch, items, sizeof(Value) * mid);
+  int left = 0;
+  int right = mid;
+  int out = 0;
+  while (left < mid && right < count) {
+    if (sortLess(context, items[right], scratch[left])) {
+      items[out++] = items[right++];
+    } else {
+      items[out++] = scratch[left++];
+    }
+  }
+  while (left < mid) {
+    items[out++] = scratch[left++];
+  }
+}
+
+static int sortDepthLimit(int count) {
+  int depth = 0;
+  while (count > 1) {
+    depth += 2;
+    count >>= 1;
+  }
+  return depth;
+}
+
+// Picks the comparison for an array without a comparator. Strings are
+// flattened up front so comparing them never allocates.
+static bool chooseSortMode(ObjArray *array, SortMode *mode) {
+  if (array->kind == ELEMENTS_NUMBERS) {
+    *mode = SORT_NUMBERS;
+    return true;
+  }
+  Value *values = array->values.values;
+  int count = array->values.count;
+  bool allNumbers = true;
+  bool allStrings = true;
+  for (int i = 0; i < count && (allNumbers || allStrings); i++) {
+    allNumbers = allNumbers && IS_NUMBER(values[i]);
+    allStrings = allStrings && IS_STRING(values[i]);
+  }
+  if (allStrings) {
+    for (int i = 0; i < count; i++) {
+      flattenString(AS_STRING(array->values.values[i]));
+    }
+    *mode = SORT_STRINGS;
+    return true;
+  }
+  if (allNumbers) {
+    *mode = SORT_NUMBERS;
+    return true;
+  }
+  return false;
+}
+
+static Value sortArray(Value *receiver, int argCount, Value *args, bool stable) {
+  if (argCount > 1) {
+    // runtimeError("Expected 0 or 1 arguments for 'sort' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if (!IS_ARRAY(*receiver)) {
+    // runtimeError("Value is not an array.");
+    return NIL_VAL;
+  }
+  ObjArray *array = AS_ARRAY(*receiver);
+  SortContext context = { SORT_COMPARATOR, NIL_VAL, false, false };
+  if (argCount == 1) {
+    if (!isCallable(args[0])) {
+      // runtimeError("Expected a comparator function.");
+      return NIL_VAL;
+    }
+    context.comparator = args[0];
+  } else if (!chooseSortMode(array, &context.mode)) {
+    // runtimeError("Arrays of mixed types need a comparator.");
+    return NIL_VAL;
+  }
+
+  int count = array->values.count;
+  if (count < 2) {
+    return *receiver;
+  }
+
+  // The comparator could change the array underneath the sort, so it sorts
+  // a copy that's written back at the end. Sorting without one can't collect
+  // garbage and works in place.
+  ObjArray *work = array;
+  int roots = 0;
+  if (context.mode == SORT_COMPARATOR) {
+    work = newArray();
+    push(OBJ_VAL(work));
+    roots++;
+    reserveValueArray(&work->values, count);
+    memcpy(work->values.values, array->values.values, sizeof(Value) * count);
+    work->values.count = count;
+    work->kind = array->kind;
+  }
+
+  if (stable) {
+    ObjArray *scratch = newArray();
+    push(OBJ_VAL(scratch));
+    roots++;
+    int scratchCount = count / 2 + 1;
+    reserveValueArray(&scratch->values, scratchCount);
+    for (int i = 0; i < scratchCount; i++) {
+      scratch->values.values[i] = NIL_VAL;
+    }
+    scratch->values.count = scratchCount;
+    mergeSort(&context, work->values.values, scratch->values.values, count);
+  } else {
+    introSort(&context, work->values.values, count, sortDepthLimit(count));
+  }
+
+  if (context.vmFailed) {
+    return NIL_VAL;
+  }
+  if (work != array && !context.badResult) {
+    reserveValueArray(&array->values, count);
+    memcpy(array->values.values, work->values.values, sizeof(Value) * count);
+    array->values.count = count;
+    array->kind = work->kind;
+  }
+  vm.stackTop -= roots;
+  if (context.badResult) {
+    // runtimeError("Comparator must return a number.");
+    return NIL_VAL;
+  }
+  return *receiver;
+}
+
+Value array_sort(Value *receiver, int argCount, Value *args) {
+  return sortArray(receiver, argCount, args, false);
+}
+
+Value array_sort_stable(Value *receiver, int argCount, Value *args) {
+  return sortArray(receiver, argCount, args, true);
+}
+
+// Three way version of sortLess for searching, calling the comparator once
+static inline int sortOrder(SortContext *context, Value a, Value b) {
+  switch (context->mode) {
+    case SORT_NUMBERS:
+      return sortLess(context, a, b) ? -1 : sortLess(context, b, a) ? 1 : 0;
+    case SORT_STRINGS:
+      return compareStrings(AS_STRING(a), AS_STRING(b));
+    case SORT_COMPARATOR: {
+      Value callbackArgs[2] = { a, b };
+      Value result;
+      if (!vmCall(context->comparator, 2, callbackArgs, &result)) {
+        context->vmFailed = true;
+        return 0;
+      }
+      if (!IS_NUMBER(result)) {
+        context->badResult = true;
+        return 0;
+      }
+      return AS_NUMBER(result) < 0 ? -1 : AS_NUMBER(result) > 0 ? 1 : 0;
+    }
+  }
+  return 0;
+}
+
+// Returns the index of a matching element in a sorted array, or
+// -(insertion point) - 1 when there isn't one. The comparator is called as
+// comparator(element, value).
+Value array_binary_search(Value *receiver, int argCount, Value *args) {
+  if (argCount != 1 && argCount != 2) {
+    // runtimeError("Expected 1 or 2 arguments for 'binarySearch' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if (!IS_ARRAY(*receiver)) {
+    // runtimeError("Value is not an array.");
+    return NIL_VAL;
+  }
+  SortContext context = { SORT_COMPARATOR, NIL_VAL, false, false };
+  if (argCount == 2) {
+    if (!isCallable(args[1])) {
+      // runtimeError("Expected a comparator function.");
+      return NIL_VAL;
+    }
+    context.comparator = args[1];
+  } else if (IS_NUMBER(args[0])) {
+    context.mode = SORT_NUMBERS;
+  } else if (IS_STRING(args[0])) {
+    context.mode = SORT_STRINGS;
+    flattenString(AS_STRING(args[0]));
+  } else {
+    // runtimeError("Expected a number, a string or a comparator.");
+    return NIL_VAL;
+  }
+
+  ObjArray *array = AS_ARRAY(*receiver);
+  Value target = args[0];
+  int low = 0;
+  int high = array->values.count;
+  // The comparator may shrink the array, so the bound is checked each time
+  while (low < high && low < array->values.count) {
+    int mid = low + (high - low) / 2;
+    if (mid >= array->values.count) {
+      high = mid;
+      continue;
+    }
+    Value element = array->values.values[mid];
+    if (context.mode == SORT_NUMBERS && !IS_NUMBER(element)) {
+      // runtimeError("Array contains a value that is not a number.");
+      return NIL_VAL;
+    }
+    if (context.mode == SORT_STRINGS) {
+      if (!IS_STRING(element)) {
+        // runtimeError("Array contains a value that is not a string.");
+        return NIL_VAL;
+      }
+      flattenString(AS_STRING(element));
+    }
+    int order = sortOrder(&context, element, target);
+    if (context.vmFailed || context.badResult) {
+      return NIL_VAL;
+    }
+    if (order < 0) {
+      low = mid + 1;
+    } else if (order > 0) {
+      high = mid;
+    } else {
+      return NUMBER_VAL(mid);
+    }
+  }
+  return NUMBER_VAL(-low - 1);
 }
@@ -29,15 +29,22 @@ Value bufferConstructor(Value *receiver, int argCount, Value* args) {
     value = newBuffer(AS_BUFFER(args[0])->size);
     memcpy(value->bytes, AS_BUFFER(args[0])->bytes, value->size);
   } else if(argCount == 1 && IS_ARRAY(args[0])) {
-    value = newBuffer(AS_ARRAY(args[0])->values.count);
-    for(int i = 0; i < AS_ARRAY(args[0])->values.count; i++) {
-      Value val = AS_ARRAY(args[0])->values.values[i];
-      if(IS_NUMBER(val) && (uint8_t)AS_NUMBER(val) <= 255 && (uint8_t)AS_NUMBER(val) >= 0) {
-        value->bytes[i] = (uint8_t)AS_NUMBER(val);
-      } else {
-        // runtimeError("Array contains value that is not a number <= 255 and >= 0.");
+    ObjArray *array = AS_ARRAY(args[0]);
+    value = newBuffer(array->values.count);
+    // Arrays that only ever held numbers skip the type check
+    bool numbers = array->kind == ELEMENTS_NUMBERS;
+    for(int i = 0; i < array->values.count; i++) {
+      Value val = array->values.values[i];
+      if(!numbers && !IS_NUMBER(val)) {
+        // runtimeError("Array contains value that is not an integer from 0 to 255.");
         return NIL_VAL;
       }
+      double number = AS_NUMBER(val);
+      if(!isByteValue(number)) {
+        // runtimeError("Array contains value that is not an integer from 0 to 255.");
+        return NIL_VAL;
+      }
+      value->bytes[i] = (uint8_t)number;
     }
   } else if(argCount == 1 && IS_STRING(args[0])) {
     value = newBuffer(AS_STRING(args[0])->length);
@@ -106,6 +113,10 @@ Value buffer_set(Value *receiver, int argCount, Value* args) {
     // runtimeError("Index out of bounds.");
     return NIL_VAL;
   }
+  if(!isByteValue(AS_NUMBER(args[1]))) {
+    // runtimeError("Value is not an integer from 0 to 255.");
+    return NIL_VAL;
+  }
   buffer->bytes[index] = (uint8_t)AS_NUMBER(args[1]);
   return NIL_VAL;
 }
@@ -123,7 +134,7 @@ Value buffer_as_array(Value *receiver, int argCount, Value* args) {
   ObjArray *array = newArray();
   push(OBJ_VAL(array));
   for(int i = 0; i < buffer->size; i++) {
-    writeValueArray(&array->values, NUMBER_VAL(buffer->bytes[i]));
+    writeArray(array, NUMBER_VAL(buffer->bytes[i]));
   }
   pop();
   return OBJ_VAL(array);
@@ -139,10 +150,8 @@ Value buffer_as_string(Value *receiver, int argCount, Value* args) {
     return NIL_VAL;
   }
   ObjBuffer *buffer = AS_BUFFER(*receiver);
-  char* heapChars = ALLOCATE(char, buffer->size + 1);
-  memcpy_uint8_t_char(heapChars, buffer->bytes, buffer->size);
-  heapChars[buffer->size] = '\0';
-  ObjString *string = takeString(heapChars, buffer->size);
+  ObjString *string = allocateString(buffer->size);
+  memcpy_uint8_t_char(string->chars, buffer->bytes, buffer->size);
   return OBJ_VAL(string);
 }
 
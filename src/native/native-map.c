@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "object.h"
+#include "memory.h"
+#include "valuetable.h"
+#include "vm.h"
+
+// Map() or Map(pairs) where pairs is an array of [key, value] arrays
+Value mapConstructor(Value *receiver, int argCount, Value* args) {
+  if(argCount > 1) {
+    // runtimeError("Expected 0 or 1 arguments for 'Map' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(argCount == 1 && !IS_ARRAY(args[0])) {
+    // runtimeError("Expected an array of [key, value] pairs.");
+    return NIL_VAL;
+  }
+  ObjMap *map = newMap();
+  if(argCount == 0) {
+    return OBJ_VAL(map);
+  }
+  push(OBJ_VAL(map));
+  ObjArray *pairs = AS_ARRAY(args[0]);
+  for(int i = 0; i < pairs->values.count; i++) {
+    Value pair = pairs->values.values[i];
+    if(!IS_ARRAY(pair) || AS_ARRAY(pair)->values.count != 2) {
+      // runtimeError("Expected an array of [key, value] pairs.");
+      pop();
+      return NIL_VAL;
+    }
+    valueTableSet(&map->table, AS_ARRAY(pair)->values.values[0],
+                  AS_ARRAY(pair)->values.values[1]);
+  }
+  pop();
+  return OBJ_VAL(map);
+}
+
+Value map_size(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'size' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(AS_MAP(*receiver)->table.count);
+}
+
+// get(key) or get(key, default), which saves a has() for counting patterns
+Value map_get(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1 && argCount != 2) {
+    // runtimeError("Expected 1 or 2 arguments for 'get' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  Value value;
+  if(valueTableGet(&AS_MAP(*receiver)->table, args[0], &value)) {
+    return value;
+  }
+  return argCount == 2 ? args[1] : NIL_VAL;
+}
+
+Value map_set(Value *receiver, int argCount, Value* args) {
+  if(argCount != 2) {
+    // runtimeError("Expected 2 arguments for 'set' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  valueTableSet(&AS_MAP(*receiver)->table, args[0], args[1]);
+  return *receiver;
+}
+
+Value map_has(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'has' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  Value value;
+  return BOOL_VAL(valueTableGet(&AS_MAP(*receiver)->table, args[0], &value));
+}
+
+Value map_delete(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'delete' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return BOOL_VAL(valueTableDelete(&AS_MAP(*receiver)->table, args[0]));
+}
+
+static Value collectEntries(ValueTable *table, bool keys) {
+  ObjArray *array = newArray();
+  push(OBJ_VAL(array));
+  reserveValueArray(&array->values, table->count);
+  for(int i = 0; i < table->entryCount; i++) {
+    ValueEntry *entry = &table->entries[i];
+    if(entry->live) {
+      writeArray(array, keys ? entry->key : entry->value);
+    }
+  }
+  pop();
+  return OBJ_VAL(array);
+}
+
+Value map_keys(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'keys' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return collectEntries(&AS_MAP(*receiver)->table, true);
+}
+
+Value map_values(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'values' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return collectEntries(&AS_MAP(*receiver)->table, false);
+}
+
+// Calls callback(value, key) in insertion order. The callback may change
+// the map, so the entries are read again on every iteration.
+Value map_foreach(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'forEach' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ValueTable *table = &AS_MAP(*receiver)->table;
+  for(int i = 0; i < table->entryCount; i++) {
+    ValueEntry *entry = &table->entries[i];
+    if(!entry->live) {
+      continue;
+    }
+    Value callbackArgs[2] = { entry->value, entry->key };
+    Value ignored;
+    if(!vmCall(args[0], 2, callbackArgs, &ignored)) {
+      return NIL_VAL;
+    }
+  }
+  return NIL_VAL;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "object.h"
+#include "memory.h"
+#include "valuetable.h"
+#include "vm.h"
+
+static void addArray(ObjSet *set, ObjArray *array) {
+  for(int i = 0; i < array->values.count; i++) {
+    valueTableSet(&set->table, array->values.values[i], NIL_VAL);
+  }
+}
+
+// Set() or Set(array), which drops the duplicates from the array
+Value setConstructor(Value *receiver, int argCount, Value* args) {
+  if(argCount > 1) {
+    // runtimeError("Expected 0 or 1 arguments for 'Set' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(argCount == 1 && !IS_ARRAY(args[0])) {
+    // runtimeError("Expected an array.");
+    return NIL_VAL;
+  }
+  ObjSet *set = newSet();
+  if(argCount == 1) {
+    push(OBJ_VAL(set));
+    addArray(set, AS_ARRAY(args[0]));
+    pop();
+  }
+  return OBJ_VAL(set);
+}
+
+Value set_size(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'size' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(AS_SET(*receiver)->table.count);
+}
+
+Value set_add(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'add' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  valueTableSet(&AS_SET(*receiver)->table, args[0], NIL_VAL);
+  return *receiver;
+}
+
+Value set_has(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'has' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  Value ignored;
+  return BOOL_VAL(valueTableGet(&AS_SET(*receiver)->table, args[0], &ignored));
+}
+
+Value set_delete(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'delete' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return BOOL_VAL(valueTableDelete(&AS_SET(*receiver)->table, args[0]));
+}
+
+Value set_values(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'values' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ValueTable *table = &AS_SET(*receiver)->table;
+  ObjArray *array = newArray();
+  push(OBJ_VAL(array));
+  reserveValueArray(&array->values, table->count);
+  for(int i = 0; i < table->entryCount; i++) {
+    if(table->entries[i].live) {
+      writeArray(array, table->entries[i].key);
+    }
+  }
+  pop();
+  return OBJ_VAL(array);
+}
+
+// Calls callback(value) in insertion order. The callback may change the
+// set, so the entries are read again on every iteration.
+Value set_foreach(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'forEach' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ValueTable *table = &AS_SET(*receiver)->table;
+  for(int i = 0; i < table->entryCount; i++) {
+    if(!table->entries[i].live) {
+      continue;
+    }
+    Value value = table->entries[i].key;
+    Value ignored;
+    if(!vmCall(args[0], 1, &value, &ignored)) {
+      return NIL_VAL;
+    }
+  }
+  return NIL_VAL;
+}
+
+// The bulk operations take another set or an array and return a new set
+// in the receiver's order, followed by anything union adds from the other.
+// An array argument is turned into a set first, which is left on the stack
+// as the second root.
+static ObjSet* otherSet(Value other) {
+  if(IS_SET(other)) {
+    push(other);
+    return AS_SET(other);
+  }
+  ObjSet *set = newSet();
+  push(OBJ_VAL(set));
+  addArray(set, AS_ARRAY(other));
+  return set;
+}
+
+typedef enum {
+  SET_UNION,
+  SET_INTERSECT,
+  SET_DIFFERENCE,
+} SetOperation;
+
+static Value combineSets(Value *receiver, int argCount, Value* args,
+                         SetOperation operation) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_SET(args[0]) && !IS_ARRAY(args[0])) {
+    // runtimeError("Expected a set or an array.");
+    return NIL_VAL;
+  }
+  ObjSet *result = newSet();
+  push(OBJ_VAL(result));
+  ObjSet *other = otherSet(args[0]);
+  ValueTable *table = &AS_SET(*receiver)->table;
+  switch(operation) {
+    case SET_UNION:
+      valueTableAddAll(table, &result->table);
+      valueTableAddAll(&other->table, &result->table);
+      break;
+    case SET_INTERSECT:
+      valueTableAddFiltered(table, &other->table, true, &result->table);
+      break;
+    case SET_DIFFERENCE:
+      valueTableAddFiltered(table, &other->table, false, &result->table);
+      break;
+  }
+  pop();
+  pop();
+  return OBJ_VAL(result);
+}
+
+Value set_union(Value *receiver, int argCount, Value* args) {
+  return combineSets(receiver, argCount, args, SET_UNION);
+}
+
+Value set_intersect(Value *receiver, int argCount, Value* args) {
+  return combineSets(receiver, argCount, args, SET_INTERSECT);
+}
+
+Value set_difference(Value *receiver, int argCount, Value* args) {
+  return combineSets(receiver, argCount, args, SET_DIFFERENCE);
+}
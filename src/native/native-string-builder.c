@@ -0,0 +1,139 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "object.h"
+#include "memory.h"
+#include "number.h"
+#include "vm.h"
+
+Value stringBuilderConstructor(Value *receiver, int argCount, Value* args) {
+  if(argCount == 1 && IS_NUMBER(args[0])) {
+    double capacity = AS_NUMBER(args[0]);
+    if(capacity >= INT_MAX) {
+      // runtimeError("StringBuilder capacity is too large.");
+      return NIL_VAL;
+    }
+    return OBJ_VAL(newStringBuilder(capacity > 0 ? (int)capacity : 0));
+  }
+  if(argCount == 1 && IS_STRING(args[0])) {
+    ObjString *string = AS_STRING(args[0]);
+    ObjStringBuilder *builder = newStringBuilder(string->length);
+    push(OBJ_VAL(builder));
+    if(!stringBuilderAppend(builder, string->chars, string->length)) {
+      pop();
+      // runtimeError("String is too long for a string builder.");
+      return NIL_VAL;
+    }
+    return pop();
+  }
+  return OBJ_VAL(newStringBuilder(0));
+}
+
+Value string_builder_length(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'length' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING_BUILDER(*receiver)) {
+    // runtimeError("Value is not a string builder.");
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(AS_STRING_BUILDER(*receiver)->length);
+}
+
+Value string_builder_append(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'append' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING_BUILDER(*receiver)) {
+    // runtimeError("Value is not a string builder.");
+    return NIL_VAL;
+  }
+  if(!IS_STRING(args[0])) {
+    // runtimeError("Argument is not a string.");
+    return NIL_VAL;
+  }
+  ObjString *string = AS_STRING(args[0]);
+  if(!stringBuilderAppend(AS_STRING_BUILDER(*receiver), string->chars, string->length)) {
+    // runtimeError("String builder result is too long.");
+    return NIL_VAL;
+  }
+  return *receiver;
+}
+
+Value string_builder_append_number(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'appendNumber' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING_BUILDER(*receiver)) {
+    // runtimeError("Value is not a string builder.");
+    return NIL_VAL;
+  }
+  if(!IS_NUMBER(args[0])) {
+    // runtimeError("Argument is not a number.");
+    return NIL_VAL;
+  }
+  char buffer[NUMBER_BUFFER_SIZE];
+  int length = formatNumber(AS_NUMBER(args[0]), buffer);
+  if(!stringBuilderAppend(AS_STRING_BUILDER(*receiver), buffer, length)) {
+    // runtimeError("String builder result is too long.");
+    return NIL_VAL;
+  }
+  return *receiver;
+}
+
+Value string_builder_append_buffer(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'appendBuffer' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING_BUILDER(*receiver)) {
+    // runtimeError("Value is not a string builder.");
+    return NIL_VAL;
+  }
+  if(!IS_BUFFER(args[0])) {
+    // runtimeError("Argument is not a buffer.");
+    return NIL_VAL;
+  }
+  ObjBuffer *buffer = AS_BUFFER(args[0]);
+  if(!stringBuilderAppend(AS_STRING_BUILDER(*receiver), (const char*)buffer->bytes, buffer->size)) {
+    // runtimeError("String builder result is too long.");
+    return NIL_VAL;
+  }
+  return *receiver;
+}
+
+Value string_builder_to_string(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'toString' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING_BUILDER(*receiver)) {
+    // runtimeError("Value is not a string builder.");
+    return NIL_VAL;
+  }
+  ObjStringBuilder *builder = AS_STRING_BUILDER(*receiver);
+  return OBJ_VAL(newString(builder->chars, builder->length));
+}
+
+Value string_builder_clear(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'clear' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING_BUILDER(*receiver)) {
+    // runtimeError("Value is not a string builder.");
+    return NIL_VAL;
+  }
+  ObjStringBuilder *builder = AS_STRING_BUILDER(*receiver);
+  builder->length = 0;
+  if(builder->capacity > 0) {
+    builder->chars[0] = '\0';
+  }
+  return *receiver;
+}
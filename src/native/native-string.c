@@ -1,6 +1,16 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// AVX-512 and AVX2 are picked at runtime, so the binary still runs on older
+// CPUs
+#define SEARCH_DISPATCH
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
 #include "object.h"
@@ -9,6 +19,239 @@
 #include "table.h"
 #include "vm.h"
 
+// The scanners below test the first and the last byte of the needle at a
+// block of 64 candidate positions starting at *start, and return the block
+// with a bit set for each position matching both. Only those positions are
+// compared in full. When no block is left to scan they return 0 with *start
+// at the first position they haven't ruled out. They call nothing, so the
+// needle bytes stay in registers, and callers verify candidates between
+// calls.
+#define SCAN_BLOCK 64
+
+typedef uint64_t (*BlockScanner)(const char* haystack, int lastStart,
+                                 char first, char last, int needleLength,
+                                 int* start);
+
+#ifdef SEARCH_DISPATCH
+// Most blocks straddle a cache line boundary in one of their loads. Aligning
+// the first byte loads to the vector size means only the last byte loads do.
+__attribute__((target("avx512bw")))
+static uint64_t scanBlocksAVX512(const char* haystack, int lastStart,
+                                 char first, char last, int needleLength,
+                                 int* start) {
+  __m512i firstBytes = _mm512_set1_epi8(first);
+  __m512i lastBytes = _mm512_set1_epi8(last);
+  const char* tail = haystack + needleLength - 1;
+  int i = *start;
+  if(i + SCAN_BLOCK - 1 > lastStart) {
+    return 0;
+  }
+  int misalignment = (int)((uintptr_t)(haystack + i) & (SCAN_BLOCK - 1));
+  if(misalignment != 0) {
+    uint64_t mask =
+        _mm512_cmpeq_epi8_mask(firstBytes, _mm512_loadu_si512(haystack + i)) &
+        _mm512_cmpeq_epi8_mask(lastBytes, _mm512_loadu_si512(tail + i));
+    if(mask != 0) {
+      return mask;
+    }
+    i += SCAN_BLOCK - misalignment;
+  }
+  for(; i + SCAN_BLOCK - 1 <= lastStart; i += SCAN_BLOCK) {
+    uint64_t mask =
+        _mm512_cmpeq_epi8_mask(firstBytes, _mm512_load_si512(haystack + i)) &
+        _mm512_cmpeq_epi8_mask(lastBytes, _mm512_loadu_si512(tail + i));
+    if(mask != 0) {
+      *start = i;
+      return mask;
+    }
+  }
+  *start = i;
+  return 0;
+}
+
+__attribute__((target("avx2")))
+static uint64_t scanBlocksAVX2(const char* haystack, int lastStart,
+                               char first, char last, int needleLength,
+                               int* start) {
+  __m256i firstBytes = _mm256_set1_epi8(first);
+  __m256i lastBytes = _mm256_set1_epi8(last);
+  const char* tail = haystack + needleLength - 1;
+  int i = *start;
+  for(; i + SCAN_BLOCK - 1 <= lastStart; i += SCAN_BLOCK) {
+    __m256i low = _mm256_and_si256(
+        _mm256_cmpeq_epi8(firstBytes, _mm256_loadu_si256((const __m256i*)(haystack + i))),
+        _mm256_cmpeq_epi8(lastBytes, _mm256_loadu_si256((const __m256i*)(tail + i))));
+    __m256i high = _mm256_and_si256(
+        _mm256_cmpeq_epi8(firstBytes, _mm256_loadu_si256((const __m256i*)(haystack + i + 32))),
+        _mm256_cmpeq_epi8(lastBytes, _mm256_loadu_si256((const __m256i*)(tail + i + 32))));
+    __m256i either = _mm256_or_si256(low, high);
+    if(!_mm256_testz_si256(either, either)) {
+      *start = i;
+      return (uint32_t)_mm256_movemask_epi8(low) |
+          ((uint64_t)(uint32_t)_mm256_movemask_epi8(high) << 32);
+    }
+  }
+  *start = i;
+  return 0;
+}
+#endif
+
+#if defined(SEARCH_DISPATCH) || defined(__SSE2__)
+static uint64_t scanBlocksSSE2(const char* haystack, int lastStart,
+                               char first, char last, int needleLength,
+                               int* start) {
+  __m128i firstBytes = _mm_set1_epi8(first);
+  __m128i lastBytes = _mm_set1_epi8(last);
+  const char* tail = haystack + needleLength - 1;
+  int i = *start;
+  for(; i + SCAN_BLOCK - 1 <= lastStart; i += SCAN_BLOCK) {
+    uint64_t mask = 0;
+    for(int part = 0; part < SCAN_BLOCK; part += 16) {
+      __m128i matches = _mm_and_si128(
+          _mm_cmpeq_epi8(firstBytes, _mm_loadu_si128((const __m128i*)(haystack + i + part))),
+          _mm_cmpeq_epi8(lastBytes, _mm_loadu_si128((const __m128i*)(tail + i + part))));
+      mask |= (uint64_t)(unsigned)_mm_movemask_epi8(matches) << part;
+    }
+    if(mask != 0) {
+      *start = i;
+      return mask;
+    }
+  }
+  *start = i;
+  return 0;
+}
+#endif
+
+static BlockScanner blockScanner() {
+#ifdef SEARCH_DISPATCH
+  static BlockScanner scanner = NULL;
+  if(scanner == NULL) {
+    if(__builtin_cpu_supports("avx512bw")) {
+      scanner = scanBlocksAVX512;
+    } else if(__builtin_cpu_supports("avx2")) {
+      scanner = scanBlocksAVX2;
+    } else {
+      scanner = scanBlocksSSE2;
+    }
+  }
+  return scanner;
+#elif defined(__SSE2__)
+  return scanBlocksSSE2;
+#else
+  return NULL;
+#endif
+}
+
+// Returns the first occurrence of needle in haystack, or NULL. Both are
+// bounded by their lengths, so embedded NUL bytes are matched like any other.
+// find(), findAll(), count(), split() and replace() all search through here.
+static const char* findSubstring(const char* haystack, int length,
+                                 const char* needle, int needleLength) {
+  if(needleLength == 0) {
+    return haystack;
+  }
+  if(needleLength > length) {
+    return NULL;
+  }
+  if(needleLength == 1) {
+    return memchr(haystack, needle[0], length);
+  }
+  int lastStart = length - needleLength;
+  int i = 0;
+  BlockScanner scan = blockScanner();
+  if(scan != NULL) {
+    uint64_t candidates;
+    while((candidates = scan(haystack, lastStart, needle[0],
+                             needle[needleLength - 1], needleLength, &i)) != 0) {
+      for(; candidates != 0; candidates &= candidates - 1) {
+        const char* candidate = haystack + i + __builtin_ctzll(candidates);
+        if(memcmp(candidate + 1, needle + 1, needleLength - 2) == 0) {
+          return candidate;
+        }
+      }
+      i += SCAN_BLOCK;
+    }
+  }
+  const char* candidate = haystack + i;
+  const char* end = haystack + lastStart + 1;
+  while(candidate < end) {
+    candidate = memchr(candidate, needle[0], end - candidate);
+    if(candidate == NULL) {
+      return NULL;
+    }
+    if(memcmp(candidate + 1, needle + 1, needleLength - 1) == 0) {
+      return candidate;
+    }
+    candidate++;
+  }
+  return NULL;
+}
+
+#define REPLACE_INLINE_MATCHES 64
+
+// Replaces up to maxMatches occurrences of search, all of them when
+// maxMatches is negative. The match offsets are collected first so the result
+// is allocated once, at its final size. Returns the string itself when
+// nothing matches and NULL when the result would be too long.
+static ObjString* replaceMatches(ObjString* string, ObjString* search,
+                                 ObjString* replacement, int maxMatches) {
+  if(search->length == 0 || maxMatches == 0) {
+    return string;
+  }
+  int inlineMatches[REPLACE_INLINE_MATCHES];
+  int* matches = inlineMatches;
+  int matchCapacity = REPLACE_INLINE_MATCHES;
+  int matchCount = 0;
+
+  const char* chars = string->chars;
+  int offset = 0;
+  while(maxMatches < 0 || matchCount < maxMatches) {
+    const char* match = findSubstring(chars + offset, string->length - offset,
+                                      search->chars, search->length);
+    if(match == NULL) {
+      break;
+    }
+    if(matchCount == matchCapacity) {
+      int* grown = malloc(sizeof(int) * matchCapacity * 2);
+      if(grown == NULL) {
+        break;
+      }
+      memcpy(grown, matches, sizeof(int) * matchCount);
+      if(matches != inlineMatches) {
+        free(matches);
+      }
+      matches = grown;
+      matchCapacity *= 2;
+    }
+    matches[matchCount++] = (int)(match - chars);
+    offset = (int)(match - chars) + search->length;
+  }
+
+  ObjString* result = string;
+  int64_t resultLength = string->length +
+      (int64_t)matchCount * (replacement->length - search->length);
+  if(resultLength > INT_MAX) {
+    result = NULL;
+  } else if(matchCount > 0) {
+    result = allocateString((int)resultLength);
+    // allocateString() may collect, but strings never move
+    char* out = result->chars;
+    int copied = 0;
+    for(int i = 0; i < matchCount; i++) {
+      memcpy(out, chars + copied, matches[i] - copied);
+      out += matches[i] - copied;
+      memcpy(out, replacement->chars, replacement->length);
+      out += replacement->length;
+      copied = matches[i] + search->length;
+    }
+    memcpy(out, chars + copied, string->length - copied);
+  }
+  if(matches != inlineMatches) {
+    free(matches);
+  }
+  return result;
+}
+
 Value string_length(Value *receiver, int argCount, Value* args) {
   return NUMBER_VAL((double)AS_STRING(*receiver)->length);
 }
@@ -27,7 +270,7 @@ Value string_get(Value *receiver, int argCount, Value* args) {
     // runtimeError("String.get() index out of bounds.");
     return NIL_VAL;
   }
-  return OBJ_VAL(copyString(AS_STRING(*receiver)->chars + index, 1));
+  return OBJ_VAL(charString((uint8_t)AS_STRING(*receiver)->chars[index]));
 }
 
 Value string_find(Value *receiver, int argCount, Value* args) {
@@ -39,12 +282,68 @@ Value string_find(Value *receiver, int argCount, Value* args) {
     // runtimeError("String.find() argument must be a string.");
     return NIL_VAL;
   }
+  ObjString *string = AS_STRING(*receiver);
   ObjString *needle = AS_STRING(args[0]);
-  char *result = strstr(AS_STRING(*receiver)->chars, needle->chars);
+  const char *result = findSubstring(string->chars, string->length,
+                                     needle->chars, needle->length);
   if(result == NULL) {
     return NIL_VAL;
   }
-  return NUMBER_VAL((double)(result - AS_STRING(*receiver)->chars));
+  return NUMBER_VAL((double)(result - string->chars));
+}
+
+Value string_find_all(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("String.findAll() takes exactly 1 argument (%d given).", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING(args[0])) {
+    // runtimeError("String.findAll() argument must be a string.");
+    return NIL_VAL;
+  }
+  ObjString *string = AS_STRING(*receiver);
+  ObjString *needle = AS_STRING(args[0]);
+  ObjArray *array = newArray();
+  if(needle->length == 0) {
+    return OBJ_VAL(array);
+  }
+  push(OBJ_VAL(array));
+  const char *end = string->chars + string->length;
+  const char *match = findSubstring(string->chars, string->length,
+                                    needle->chars, needle->length);
+  while(match != NULL) {
+    writeArray(array, NUMBER_VAL((double)(match - string->chars)));
+    const char *next = match + needle->length;
+    match = findSubstring(next, (int)(end - next), needle->chars, needle->length);
+  }
+  pop();
+  return OBJ_VAL(array);
+}
+
+Value string_count(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("String.count() takes exactly 1 argument (%d given).", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING(args[0])) {
+    // runtimeError("String.count() argument must be a string.");
+    return NIL_VAL;
+  }
+  ObjString *string = AS_STRING(*receiver);
+  ObjString *needle = AS_STRING(args[0]);
+  if(needle->length == 0) {
+    return NUMBER_VAL(0);
+  }
+  int count = 0;
+  const char *end = string->chars + string->length;
+  const char *match = findSubstring(string->chars, string->length,
+                                    needle->chars, needle->length);
+  while(match != NULL) {
+    count++;
+    const char *next = match + needle->length;
+    match = findSubstring(next, (int)(end - next), needle->chars, needle->length);
+  }
+  return NUMBER_VAL((double)count);
 }
 
 Value string_substring(Value *receiver, int argCount, Value* args) {
@@ -71,7 +370,7 @@ Value string_substring(Value *receiver, int argCount, Value* args) {
     // runtimeError("String.substring() length out of bounds.");
     return NIL_VAL;
   }
-  return OBJ_VAL(copyString(string->chars + start, length));
+  return OBJ_VAL(sliceString(string, start, length));
 }
 
 Value string_split(Value *receiver, int argCount, Value* args) {
@@ -86,7 +385,7 @@ Value string_split(Value *receiver, int argCount, Value* args) {
   if(AS_STRING(args[0])->length == 0) {
     ObjArray *array = newArray();
     push(OBJ_VAL(array));
-    writeValueArray(&array->values, *receiver);
+    writeArray(array, *receiver);
     pop();
     return OBJ_VAL(array);
   }
@@ -94,24 +393,51 @@ Value string_split(Value *receiver, int argCount, Value* args) {
   ObjString *string = AS_STRING(*receiver);
   ObjArray *array = newArray();
   push(OBJ_VAL(array));
-  char *start = string->chars;
-  char *end = strstr(start, delimiter->chars);
+  const char *start = string->chars;
+  const char *stringEnd = string->chars + string->length;
+  const char *end = findSubstring(start, string->length,
+                                  delimiter->chars, delimiter->length);
   while(end != NULL) {
-    Value substring = OBJ_VAL(copyString(start, end - start));
+    Value substring = OBJ_VAL(sliceString(string, (int)(start - string->chars),
+                                          (int)(end - start)));
     push(substring);
-    writeValueArray(&array->values, substring);
+    writeArray(array, substring);
     pop();
     start = end + delimiter->length;
-    end = strstr(start, delimiter->chars);
+    end = findSubstring(start, (int)(stringEnd - start),
+                        delimiter->chars, delimiter->length);
   }
-  Value endString = OBJ_VAL(copyString(start, string->length - (start - string->chars)));
+  Value endString = OBJ_VAL(sliceString(string, (int)(start - string->chars),
+                                        (int)(stringEnd - start)));
   push(endString);
-  writeValueArray(&array->values, endString);
+  writeArray(array, endString);
   pop();
   pop();
   return OBJ_VAL(array);
 }
 
+static Value replace(Value *receiver, int argCount, Value* args, int maxMatches) {
+  if(argCount != 2) {
+    // runtimeError("String.replace() takes exactly 2 arguments (%d given).", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING(args[0]) || !IS_STRING(args[1])) {
+    // runtimeError("String.replace() arguments must be strings.");
+    return NIL_VAL;
+  }
+  ObjString *result = replaceMatches(AS_STRING(*receiver), AS_STRING(args[0]),
+                                     AS_STRING(args[1]), maxMatches);
+  if(result == NULL) {
+    // runtimeError("String.replace() result is too long.");
+    return NIL_VAL;
+  }
+  return OBJ_VAL(result);
+}
+
 Value string_replace(Value *receiver, int argCount, Value* args) {
-  return callLoxCode("_string_replace", receiver, argCount, args);
+  return replace(receiver, argCount, args, -1);
+}
+
+Value string_replace_first(Value *receiver, int argCount, Value* args) {
+  return replace(receiver, argCount, args, 1);
 }
@@ -0,0 +1,721 @@
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "object.h"
+#include "memory.h"
+#include "vm.h"
+
+// The kernels below have three tiers: AVX, picked at runtime so the binary
+// still runs on older CPUs, SSE2, which every x86-64 CPU has, and plain C for
+// everything else (pico, wasm). Sums are accumulated in several lanes, so
+// their rounding depends on the tier.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define TYPED_ARRAY_SIMD
+#include <immintrin.h>
+#define AVX_KERNEL __attribute__((target("avx")))
+
+static bool hasAVX() {
+  static int supported = -1;
+  if(supported < 0) {
+    supported = __builtin_cpu_supports("avx") ? 1 : 0;
+  }
+  return supported;
+}
+#endif
+
+// Float64 kernels
+
+#ifdef TYPED_ARRAY_SIMD
+AVX_KERNEL static double sumFloat64AVX(const double *x, int n) {
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  int i = 0;
+  for(; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(x + i));
+    acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(x + i + 4));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for(; i < n; i++) {
+    sum += x[i];
+  }
+  return sum;
+}
+#endif
+
+static double sumFloat64(const double *x, int n) {
+  double sum = 0;
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  if(hasAVX()) {
+    return sumFloat64AVX(x, n);
+  }
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  for(; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_loadu_pd(x + i));
+    acc1 = _mm_add_pd(acc1, _mm_loadu_pd(x + i + 2));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  sum = lanes[0] + lanes[1];
+#endif
+  for(; i < n; i++) {
+    sum += x[i];
+  }
+  return sum;
+}
+
+#ifdef TYPED_ARRAY_SIMD
+AVX_KERNEL static double dotFloat64AVX(const double *x, const double *y, int n) {
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  int i = 0;
+  for(; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for(; i < n; i++) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+#endif
+
+static double dotFloat64(const double *x, const double *y, int n) {
+  double sum = 0;
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  if(hasAVX()) {
+    return dotFloat64AVX(x, y, n);
+  }
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  for(; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  sum = lanes[0] + lanes[1];
+#endif
+  for(; i < n; i++) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+// NaN elements are skipped, the vector min and max return their second
+// operand when either is NaN
+#ifdef TYPED_ARRAY_SIMD
+AVX_KERNEL static double extremeFloat64AVX(const double *x, int n, bool max) {
+  __m256d acc = _mm256_set1_pd(max ? -INFINITY : INFINITY);
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    __m256d v = _mm256_loadu_pd(x + i);
+    acc = max ? _mm256_max_pd(v, acc) : _mm256_min_pd(v, acc);
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  double result = lanes[0];
+  for(int lane = 1; lane < 4; lane++) {
+    if(max ? lanes[lane] > result : lanes[lane] < result) {
+      result = lanes[lane];
+    }
+  }
+  for(; i < n; i++) {
+    if(max ? x[i] > result : x[i] < result) {
+      result = x[i];
+    }
+  }
+  return result;
+}
+#endif
+
+static double extremeFloat64(const double *x, int n, bool max) {
+  double result = max ? -INFINITY : INFINITY;
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  if(hasAVX()) {
+    return extremeFloat64AVX(x, n, max);
+  }
+  __m128d acc = _mm_set1_pd(result);
+  for(; i + 2 <= n; i += 2) {
+    __m128d v = _mm_loadu_pd(x + i);
+    acc = max ? _mm_max_pd(v, acc) : _mm_min_pd(v, acc);
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  result = (max ? lanes[1] > lanes[0] : lanes[1] < lanes[0]) ? lanes[1] : lanes[0];
+#endif
+  for(; i < n; i++) {
+    if(max ? x[i] > result : x[i] < result) {
+      result = x[i];
+    }
+  }
+  return result;
+}
+
+// x = x * factor + offset
+#ifdef TYPED_ARRAY_SIMD
+AVX_KERNEL static void scaleAddFloat64AVX(double *x, int n, double factor, double offset) {
+  __m256d f = _mm256_set1_pd(factor);
+  __m256d o = _mm256_set1_pd(offset);
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(x + i, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(x + i), f), o));
+  }
+  for(; i < n; i++) {
+    x[i] = x[i] * factor + offset;
+  }
+}
+#endif
+
+static void scaleAddFloat64(double *x, int n, double factor, double offset) {
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  if(hasAVX()) {
+    scaleAddFloat64AVX(x, n, factor, offset);
+    return;
+  }
+  __m128d f = _mm_set1_pd(factor);
+  __m128d o = _mm_set1_pd(offset);
+  for(; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(x + i, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(x + i), f), o));
+  }
+#endif
+  for(; i < n; i++) {
+    x[i] = x[i] * factor + offset;
+  }
+}
+
+// x = x + y
+#ifdef TYPED_ARRAY_SIMD
+AVX_KERNEL static void addFloat64AVX(double *x, const double *y, int n) {
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(x + i, _mm256_add_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+  }
+  for(; i < n; i++) {
+    x[i] += y[i];
+  }
+}
+#endif
+
+static void addFloat64(double *x, const double *y, int n) {
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  if(hasAVX()) {
+    addFloat64AVX(x, y, n);
+    return;
+  }
+  for(; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(x + i, _mm_add_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+  }
+#endif
+  for(; i < n; i++) {
+    x[i] += y[i];
+  }
+}
+
+typedef enum {
+  MAP_ABS,
+  MAP_NEG,
+  MAP_SQRT,
+  MAP_SQUARE,
+  MAP_FLOOR,
+  MAP_CEIL,
+  MAP_ROUND,
+} MapOp;
+
+static const char* mapOpNames[] = {
+  "abs", "neg", "sqrt", "square", "floor", "ceil", "round", NULL
+};
+
+static double mapScalar(MapOp op, double value) {
+  switch(op) {
+    case MAP_ABS: return fabs(value);
+    case MAP_NEG: return -value;
+    case MAP_SQRT: return sqrt(value);
+    case MAP_SQUARE: return value * value;
+    case MAP_FLOOR: return floor(value);
+    case MAP_CEIL: return ceil(value);
+    case MAP_ROUND: return round(value);
+  }
+  return value;
+}
+
+// Writes op(x) to out, returns how many leading elements it handled
+#ifdef TYPED_ARRAY_SIMD
+AVX_KERNEL static int mapFloat64AVX(MapOp op, const double *x, double *out, int n) {
+  __m256d sign = _mm256_set1_pd(-0.0);
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    __m256d v = _mm256_loadu_pd(x + i);
+    switch(op) {
+      case MAP_ABS: v = _mm256_andnot_pd(sign, v); break;
+      case MAP_NEG: v = _mm256_xor_pd(sign, v); break;
+      case MAP_SQRT: v = _mm256_sqrt_pd(v); break;
+      case MAP_SQUARE: v = _mm256_mul_pd(v, v); break;
+      case MAP_FLOOR: v = _mm256_floor_pd(v); break;
+      case MAP_CEIL: v = _mm256_ceil_pd(v); break;
+      case MAP_ROUND: return i; // rounds half away from zero, left to round()
+    }
+    _mm256_storeu_pd(out + i, v);
+  }
+  return i;
+}
+#endif
+
+static void mapFloat64(MapOp op, const double *x, double *out, int n) {
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  if(hasAVX()) {
+    i = mapFloat64AVX(op, x, out, n);
+  } else if(op != MAP_FLOOR && op != MAP_CEIL && op != MAP_ROUND) {
+    __m128d sign = _mm_set1_pd(-0.0);
+    for(; i + 2 <= n; i += 2) {
+      __m128d v = _mm_loadu_pd(x + i);
+      switch(op) {
+        case MAP_ABS: v = _mm_andnot_pd(sign, v); break;
+        case MAP_NEG: v = _mm_xor_pd(sign, v); break;
+        case MAP_SQRT: v = _mm_sqrt_pd(v); break;
+        default: v = _mm_mul_pd(v, v); break;
+      }
+      _mm_storeu_pd(out + i, v);
+    }
+  }
+#endif
+  for(; i < n; i++) {
+    out[i] = mapScalar(op, x[i]);
+  }
+}
+
+// Int32 and Uint8 kernels, SSE2 covers them well enough
+
+static double sumInt32(const int32_t *x, int n) {
+  int64_t sum = 0;
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  __m128i zero = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+  for(; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+    __m128i sign = _mm_cmpgt_epi32(zero, v);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+  }
+  int64_t lanes[2];
+  _mm_storeu_si128((__m128i*)lanes, acc);
+  sum = lanes[0] + lanes[1];
+#endif
+  for(; i < n; i++) {
+    sum += x[i];
+  }
+  return (double)sum;
+}
+
+static double extremeInt32(const int32_t *x, int n, bool max) {
+  int32_t result = max ? INT32_MIN : INT32_MAX;
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  __m128i acc = _mm_set1_epi32(result);
+  for(; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+    __m128i take = max ? _mm_cmpgt_epi32(v, acc) : _mm_cmpgt_epi32(acc, v);
+    acc = _mm_or_si128(_mm_and_si128(take, v), _mm_andnot_si128(take, acc));
+  }
+  int32_t lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, acc);
+  for(int lane = 0; lane < 4; lane++) {
+    if(max ? lanes[lane] > result : lanes[lane] < result) {
+      result = lanes[lane];
+    }
+  }
+#endif
+  for(; i < n; i++) {
+    if(max ? x[i] > result : x[i] < result) {
+      result = x[i];
+    }
+  }
+  return result;
+}
+
+static double sumUint8(const uint8_t *x, int n) {
+  uint64_t sum = 0;
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  __m128i zero = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+  for(; i + 16 <= n; i += 16) {
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(x + i)), zero));
+  }
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i*)lanes, acc);
+  sum = lanes[0] + lanes[1];
+#endif
+  for(; i < n; i++) {
+    sum += x[i];
+  }
+  return (double)sum;
+}
+
+static double extremeUint8(const uint8_t *x, int n, bool max) {
+  uint8_t result = max ? 0 : 255;
+  int i = 0;
+#ifdef TYPED_ARRAY_SIMD
+  __m128i acc = _mm_set1_epi8((char)result);
+  for(; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+    acc = max ? _mm_max_epu8(acc, v) : _mm_min_epu8(acc, v);
+  }
+  uint8_t lanes[16];
+  _mm_storeu_si128((__m128i*)lanes, acc);
+  for(int lane = 0; lane < 16; lane++) {
+    if(max ? lanes[lane] > result : lanes[lane] < result) {
+      result = lanes[lane];
+    }
+  }
+#endif
+  for(; i < n; i++) {
+    if(max ? x[i] > result : x[i] < result) {
+      result = x[i];
+    }
+  }
+  return result;
+}
+
+static double sumElements(ObjTypedArray *array) {
+  switch(array->kind) {
+    case TYPED_FLOAT64: return sumFloat64(array->data, array->length);
+    case TYPED_INT32: return sumInt32(array->data, array->length);
+    case TYPED_UINT8: return sumUint8(array->data, array->length);
+  }
+  return 0;
+}
+
+static double extremeElement(ObjTypedArray *array, bool max) {
+  switch(array->kind) {
+    case TYPED_FLOAT64: return extremeFloat64(array->data, array->length, max);
+    case TYPED_INT32: return extremeInt32(array->data, array->length, max);
+    case TYPED_UINT8: return extremeUint8(array->data, array->length, max);
+  }
+  return 0;
+}
+
+// Constructors
+
+// Float64Array(length), Float64Array(array) or Float64Array(typedArray)
+static Value constructTypedArray(TypedArrayKind kind, int argCount, Value *args) {
+  if(argCount == 1 && IS_NUMBER(args[0])) {
+    double length = AS_NUMBER(args[0]);
+    if(!(length >= 0 && length <= INT_MAX / (int)sizeof(double))) {
+      // runtimeError("Invalid typed array length.");
+      return NIL_VAL;
+    }
+    return OBJ_VAL(newTypedArray(kind, (int)length));
+  }
+  if(argCount == 1 && IS_ARRAY(args[0])) {
+    ObjArray *source = AS_ARRAY(args[0]);
+    ObjTypedArray *array = newTypedArray(kind, source->values.count);
+#ifdef NAN_BOXING
+    // A numbers-only array already has the bits of a double array
+    if(kind == TYPED_FLOAT64 && source->kind == ELEMENTS_NUMBERS && array->length > 0) {
+      memcpy(array->data, source->values.values, sizeof(double) * array->length);
+      return OBJ_VAL(array);
+    }
+#endif
+    for(int i = 0; i < array->length; i++) {
+      Value value = source->values.values[i];
+      if(!IS_NUMBER(value)) {
+        // runtimeError("Array contains a value that is not a number.");
+        return NIL_VAL;
+      }
+      setTypedArrayElement(array, i, AS_NUMBER(value));
+    }
+    return OBJ_VAL(array);
+  }
+  if(argCount == 1 && IS_TYPED_ARRAY(args[0])) {
+    ObjTypedArray *source = AS_TYPED_ARRAY(args[0]);
+    ObjTypedArray *array = newTypedArray(kind, source->length);
+    if(source->kind == kind && array->length > 0) {
+      memcpy(array->data, source->data, TYPED_ARRAY_BYTES(array));
+      return OBJ_VAL(array);
+    }
+    for(int i = 0; i < array->length; i++) {
+      setTypedArrayElement(array, i, typedArrayElement(source, i));
+    }
+    return OBJ_VAL(array);
+  }
+  return OBJ_VAL(newTypedArray(kind, 0));
+}
+
+Value float64ArrayConstructor(Value *receiver, int argCount, Value* args) {
+  return constructTypedArray(TYPED_FLOAT64, argCount, args);
+}
+
+Value int32ArrayConstructor(Value *receiver, int argCount, Value* args) {
+  return constructTypedArray(TYPED_INT32, argCount, args);
+}
+
+Value uint8ArrayConstructor(Value *receiver, int argCount, Value* args) {
+  return constructTypedArray(TYPED_UINT8, argCount, args);
+}
+
+// Methods
+
+Value typed_array_length(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'length' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(AS_TYPED_ARRAY(*receiver)->length);
+}
+
+Value typed_array_get(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'get' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_NUMBER(args[0])) {
+    // runtimeError("Index is not a number.");
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  int index = (int)AS_NUMBER(args[0]);
+  if(index < 0 || index >= array->length) {
+    // runtimeError("Index out of bounds.");
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(typedArrayElement(array, index));
+}
+
+Value typed_array_set(Value *receiver, int argCount, Value* args) {
+  if(argCount != 2) {
+    // runtimeError("Expected 2 arguments for 'set' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_NUMBER(args[0]) || !IS_NUMBER(args[1])) {
+    // runtimeError("Index and value must be numbers.");
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  int index = (int)AS_NUMBER(args[0]);
+  if(index < 0 || index >= array->length) {
+    // runtimeError("Index out of bounds.");
+    return NIL_VAL;
+  }
+  setTypedArrayElement(array, index, AS_NUMBER(args[1]));
+  return NIL_VAL;
+}
+
+Value typed_array_sum(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'sum' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(sumElements(AS_TYPED_ARRAY(*receiver)));
+}
+
+Value typed_array_mean(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'mean' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  if(array->length == 0) {
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(sumElements(array) / array->length);
+}
+
+Value typed_array_min(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'min' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  if(array->length == 0) {
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(extremeElement(array, false));
+}
+
+Value typed_array_max(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'max' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  if(array->length == 0) {
+    return NIL_VAL;
+  }
+  return NUMBER_VAL(extremeElement(array, true));
+}
+
+Value typed_array_dot(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'dot' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_TYPED_ARRAY(args[0]) || AS_TYPED_ARRAY(args[0])->length != AS_TYPED_ARRAY(*receiver)->length) {
+    // runtimeError("Argument must be a typed array of the same length.");
+    return NIL_VAL;
+  }
+  ObjTypedArray *x = AS_TYPED_ARRAY(*receiver);
+  ObjTypedArray *y = AS_TYPED_ARRAY(args[0]);
+  if(x->kind == TYPED_FLOAT64 && y->kind == TYPED_FLOAT64) {
+    return NUMBER_VAL(dotFloat64(x->data, y->data, x->length));
+  }
+  double sum = 0;
+  for(int i = 0; i < x->length; i++) {
+    sum += typedArrayElement(x, i) * typedArrayElement(y, i);
+  }
+  return NUMBER_VAL(sum);
+}
+
+// Multiplies every element in place
+Value typed_array_scale(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'scale' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_NUMBER(args[0])) {
+    // runtimeError("Factor is not a number.");
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  double factor = AS_NUMBER(args[0]);
+  if(array->kind == TYPED_FLOAT64) {
+    scaleAddFloat64(array->data, array->length, factor, 0);
+  } else {
+    for(int i = 0; i < array->length; i++) {
+      setTypedArrayElement(array, i, typedArrayElement(array, i) * factor);
+    }
+  }
+  return *receiver;
+}
+
+// Adds a number, or the elements of a typed array of the same length, in place
+Value typed_array_add(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'add' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  if(IS_NUMBER(args[0])) {
+    double offset = AS_NUMBER(args[0]);
+    if(array->kind == TYPED_FLOAT64) {
+      scaleAddFloat64(array->data, array->length, 1, offset);
+    } else {
+      for(int i = 0; i < array->length; i++) {
+        setTypedArrayElement(array, i, typedArrayElement(array, i) + offset);
+      }
+    }
+    return *receiver;
+  }
+  if(!IS_TYPED_ARRAY(args[0]) || AS_TYPED_ARRAY(args[0])->length != array->length) {
+    // runtimeError("Argument must be a number or a typed array of the same length.");
+    return NIL_VAL;
+  }
+  ObjTypedArray *other = AS_TYPED_ARRAY(args[0]);
+  if(array->kind == TYPED_FLOAT64 && other->kind == TYPED_FLOAT64) {
+    addFloat64(array->data, other->data, array->length);
+  } else {
+    for(int i = 0; i < array->length; i++) {
+      setTypedArrayElement(array, i, typedArrayElement(array, i) + typedArrayElement(other, i));
+    }
+  }
+  return *receiver;
+}
+
+Value typed_array_fill(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'fill' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_NUMBER(args[0])) {
+    // runtimeError("Value is not a number.");
+    return NIL_VAL;
+  }
+  ObjTypedArray *array = AS_TYPED_ARRAY(*receiver);
+  double value = AS_NUMBER(args[0]);
+  switch(array->kind) {
+    case TYPED_FLOAT64:
+      for(int i = 0; i < array->length; i++) {
+        ((double*)array->data)[i] = value;
+      }
+      break;
+    case TYPED_INT32:
+      for(int i = 0; i < array->length; i++) {
+        setTypedArrayElement(array, i, value);
+      }
+      break;
+    case TYPED_UINT8:
+      if(array->length > 0) {
+        setTypedArrayElement(array, 0, value);
+        memset(array->data, ((uint8_t*)array->data)[0], array->length);
+      }
+      break;
+  }
+  return *receiver;
+}
+
+// A new typed array of the same kind with a builtin operation applied to
+// every element, see mapOpNames
+Value typed_array_map(Value *receiver, int argCount, Value* args) {
+  if(argCount != 1) {
+    // runtimeError("Expected 1 argument for 'map' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_STRING(args[0])) {
+    // runtimeError("Operation must be a string.");
+    return NIL_VAL;
+  }
+  ObjString *name = AS_STRING(args[0]);
+  int op = 0;
+  while(mapOpNames[op] != NULL &&
+        !((int)strlen(mapOpNames[op]) == name->length &&
+          memcmp(mapOpNames[op], name->chars, name->length) == 0)) {
+    op++;
+  }
+  if(mapOpNames[op] == NULL) {
+    // runtimeError("Unknown operation '%s'.", name->chars);
+    return NIL_VAL;
+  }
+  ObjTypedArray *source = AS_TYPED_ARRAY(*receiver);
+  ObjTypedArray *result = newTypedArray(source->kind, source->length);
+  if(source->kind == TYPED_FLOAT64) {
+    mapFloat64((MapOp)op, source->data, result->data, source->length);
+  } else {
+    for(int i = 0; i < source->length; i++) {
+      setTypedArrayElement(result, i, mapScalar((MapOp)op, typedArrayElement(source, i)));
+    }
+  }
+  return OBJ_VAL(result);
+}
+
+Value typed_array_to_array(Value *receiver, int argCount, Value* args) {
+  if(argCount != 0) {
+    // runtimeError("Expected 0 arguments for 'toArray' but got %d.", argCount);
+    return NIL_VAL;
+  }
+  ObjTypedArray *source = AS_TYPED_ARRAY(*receiver);
+  ObjArray *array = newArray();
+  push(OBJ_VAL(array));
+  reserveValueArray(&array->values, source->length);
+  for(int i = 0; i < source->length; i++) {
+    array->values.values[i] = NUMBER_VAL(typedArrayElement(source, i));
+  }
+  array->values.count = source->length;
+  pop();
+  return OBJ_VAL(array);
+}
@@ -10,6 +10,7 @@
 #include "vm.h"
 #include "memory.h"
 #include "compiler.h"
+#include "number.h"
 
 #ifdef PICO_MODULE
 #include <pico/stdlib.h>
@@ -50,17 +51,17 @@ Value parseRecurse(struct json_value_s *root) {
     while(element != NULL) {
       Value value = parseRecurse(element->value);
       push(value);
-      writeValueArray(&objArray->values, value);
+      writeArray(objArray, value);
       pop();
       element = element->next;
     }
     return pop();
   } else if(json_value_as_string(root) != NULL) {
     struct json_string_s *string = json_value_as_string(root);
-    return OBJ_VAL(copyString(string->string, string->string_size));
+    return OBJ_VAL(newString(string->string, string->string_size));
   } else if(json_value_as_number(root) != NULL) {
     struct json_number_s *number = json_value_as_number(root);
-    return NUMBER_VAL(strtod(number->number, NULL));
+    return NUMBER_VAL(parseNumber(number->number, (int)number->number_size));
   } else if(json_value_is_true(root)) {
     return TRUE_VAL;
   } else if(json_value_is_false(root)) {
@@ -94,8 +95,8 @@ ObjString *stringifyRecurse(Value value) {
   if(IS_BOOL(value)) {
     return valuesEqual(TRUE_VAL, value) ? copyString("true", 4) : copyString("false", 5);
   } else if(IS_NUMBER(value)) {
-    char buffer[32];
-    int length = snprintf(buffer, sizeof(buffer), "%.14g", AS_NUMBER(value));
+    char buffer[NUMBER_BUFFER_SIZE];
+    int length = formatNumber(AS_NUMBER(value), buffer);
     return copyString(buffer, length);
   } else if(IS_NIL(value)) {
     return copyString("null", 4);
@@ -103,8 +104,8 @@ ObjString *stringifyRecurse(Value value) {
     push(OBJ_VAL(copyString("\"", 1)));
     push(value); // TODO escape quotes inside string
     push(OBJ_VAL(copyString("\"", 1)));
-    concatenate();
-    concatenate();
+    if(!concatenate()) return NULL;
+    if(!concatenate()) return NULL;
     return AS_STRING(pop());
   } else if(IS_ARRAY(value)) {
     ObjArray *array = AS_ARRAY(value);
@@ -112,18 +113,19 @@ ObjString *stringifyRecurse(Value value) {
     for(int i = 0; i < array->values.count; i++) {
       ObjString *element = stringifyRecurse(array->values.values[i]);
       if(element == NULL) {
+        if(vm.hadRuntimeError) return NULL;
         // skip invalid values
         continue;
       }
       push(OBJ_VAL(element));
-      concatenate();
+      if(!concatenate()) return NULL;
       if(i != array->values.count - 1) {
         push(OBJ_VAL(copyString(", ", 2)));
-        concatenate();
+        if(!concatenate()) return NULL;
       }
     }
     push(OBJ_VAL(copyString("]", 1)));
-    concatenate();
+    if(!concatenate()) return NULL;
     return AS_STRING(pop());
   } else if(IS_INSTANCE(value)) {
     ObjInstance *instance = AS_INSTANCE(value);
@@ -139,11 +141,12 @@ ObjString *stringifyRecurse(Value value) {
       ObjString *element = stringifyRecurse(entry->value);
       if(element != NULL) {
         push(OBJ_VAL(element));
-        concatenate();
-        concatenate();
-        concatenate(); 
-        concatenate(); // concat whole stack
+        if(!concatenate()) return NULL;
+        if(!concatenate()) return NULL;
+        if(!concatenate()) return NULL;
+        if(!concatenate()) return NULL; // concat whole stack
       } else {
+        if(vm.hadRuntimeError) return NULL;
         // skip invalid values
         // Pop off if not keeping
         pop();
@@ -160,11 +163,11 @@ ObjString *stringifyRecurse(Value value) {
       pop(); // pop off last comma
       for(int i = 0; i < commas - 1; i++) {
         // concat all the commas we added
-        concatenate();
+        if(!concatenate()) return NULL;
       }
     }
     push(OBJ_VAL(copyString(" }", 2)));
-    concatenate();
+    if(!concatenate()) return NULL;
     return AS_STRING(pop());
   } else {
     return NULL;
@@ -176,7 +179,8 @@ Value stringifyJsonNative(Value *receiver, int argCount, Value *args) {
     // runtimeError("parseJson() takes exactly 1 argument (%d given).", argCount);
     return NIL_VAL;
   }
-  return OBJ_VAL(stringifyRecurse(args[0]));
+  ObjString *json = stringifyRecurse(args[0]);
+  return json == NULL ? NIL_VAL : OBJ_VAL(json);
 }
 
 Value scanToEOF(Value *receiver, int argCount, Value *args) {
@@ -187,8 +191,8 @@ Value scanToEOF(Value *receiver, int argCount, Value *args) {
     if(fgets(line, sizeof(line), stdin) == NULL) {
       break;
     }
-    push(OBJ_VAL(copyString(line, strlen(line))));
-    concatenate();
+    push(OBJ_VAL(newString(line, strlen(line))));
+    if(!concatenate()) return NIL_VAL;
   }
   return pop();
 }
@@ -209,7 +213,7 @@ Value getInstanceFields(Value *receiver, int argCount, Value *args) {
   while(entry != NULL) {
     ObjString *key = entry->key;
     push(OBJ_VAL(key));
-    writeValueArray(&objArray->values, OBJ_VAL(key));
+    writeArray(objArray, OBJ_VAL(key));
     pop();
     entry = tableIterate(&instance->fields, entry);
   }
@@ -359,43 +363,33 @@ static inline void setInstanceField(ObjInstance *instance, const char *name, Val
   pop();
 }
 
-// TODO reuse this elsewhere
-static inline void popTimes(int times) {
-  for(int i = 0; i < times; i++) {
-    pop();
-  }
-}
-
 Value evalNative(Value *receiver, int argCount, Value *args) {
   if(argCount != 1) {
     // runtimeError("eval() takes exactly 1 argument (%d given).", argCount);
-    popTimes(argCount);
     return NIL_VAL;
   }
   if(!IS_STRING(args[0])) {
     // runtimeError("eval() argument must be a string.");
-    popTimes(argCount);
     return NIL_VAL;
   }
 
-  const char *source = AS_CSTRING(args[0]);
-  ObjFunction *function = compileEval(source);
-
-  // Do this after compileModule() to avoid source being freed early
-  // Similar to callLoxCode(), we need to pop everything off for this native function first
-  popTimes(argCount + 1); // args + native function
-
+  ObjFunction *function = compileEval(AS_CSTRING(args[0]));
   if(function == NULL) {
     // runtimeError("eval() failed to compile.");
-    push(NIL_VAL);
     return NIL_VAL;
   }
   push(OBJ_VAL(function));
   ObjClosure* closure = newClosure(function);
   pop();
-  push(OBJ_VAL(closure));
-  callModule(closure, 0);
-  return NIL_VAL;
+  Value result;
+  if(!vmCall(OBJ_VAL(closure), 0, NULL, &result)) {
+    return NIL_VAL;
+  }
+  return result;
+}
+
+static inline double nsToMs(uint64_t ns) {
+  return (double)ns / 1000000.0;
 }
 
 Value getMemStatsNative(Value *receiver, int argCount, Value *args) {
@@ -405,15 +399,101 @@ Value getMemStatsNative(Value *receiver, int argCount, Value *args) {
   }
   ObjInstance *instance = createObjectInstance();
   push(OBJ_VAL(instance));
+  finishSweep(); // only count live objects
   int numberOfObjects = 0;
+  int objectsByType[OBJ_TYPE_COUNT] = {0};
   Obj* object = vm.objects;
   while (object != NULL) {
     numberOfObjects++;
+    objectsByType[object->type]++;
     object = object->next;
   }
   setInstanceField(instance, "vm_heap_usage", NUMBER_VAL((double)vm.bytesAllocated));
   setInstanceField(instance, "vm_next_gc", NUMBER_VAL((double)vm.nextGC));
   setInstanceField(instance, "vm_max_lifetime_usage", NUMBER_VAL((double)vm.debug_maxTotalAllocated));
   setInstanceField(instance, "vm_number_of_objects", NUMBER_VAL((double)numberOfObjects));
+  setInstanceField(instance, "vm_external_bytes", NUMBER_VAL((double)vm.externalBytes));
+  setInstanceField(instance, "vm_next_external_gc", NUMBER_VAL((double)vm.nextExternalGC));
+  double averageProbe;
+  int maxProbe;
+  tableProbeStats(&vm.strings, &averageProbe, &maxProbe);
+  setInstanceField(instance, "vm_strings_count", NUMBER_VAL((double)vm.strings.count));
+  setInstanceField(instance, "vm_strings_capacity", NUMBER_VAL((double)vm.strings.capacity));
+  setInstanceField(instance, "vm_strings_avg_probe", NUMBER_VAL(averageProbe));
+  setInstanceField(instance, "vm_strings_max_probe", NUMBER_VAL((double)maxProbe));
+  setInstanceField(instance, "vm_allocations", NUMBER_VAL((double)vm.gcStats.allocations));
+
+  ObjInstance *byType = createObjectInstance();
+  push(OBJ_VAL(byType));
+  for(int type = 0; type < OBJ_TYPE_COUNT; type++) {
+    if(objectsByType[type] > 0) {
+      setInstanceField(byType, objTypeName((ObjType)type), NUMBER_VAL((double)objectsByType[type]));
+    }
+  }
+  setInstanceField(instance, "vm_objects_by_type", peek(0));
+  pop(); // byType
+
+  GCStats *stats = &vm.gcStats;
+  setInstanceField(instance, "gc_collections", NUMBER_VAL((double)stats->collections));
+  setInstanceField(instance, "gc_total_pause_ms", NUMBER_VAL(nsToMs(stats->totalPauseNs)));
+  setInstanceField(instance, "gc_max_pause_ms", NUMBER_VAL(nsToMs(stats->maxPauseNs)));
+  setInstanceField(instance, "gc_last_pause_ms", NUMBER_VAL(nsToMs(stats->lastPauseNs)));
+  setInstanceField(instance, "gc_parallel_marks", NUMBER_VAL((double)stats->parallelMarks));
+  setInstanceField(instance, "gc_lazy_sweep_ms", NUMBER_VAL(nsToMs(stats->lazySweepNs)));
+  setInstanceField(instance, "gc_last_bytes_freed", NUMBER_VAL((double)stats->lastBytesFreed));
+  setInstanceField(instance, "gc_total_bytes_freed", NUMBER_VAL((double)stats->totalBytesFreed));
+
+  ObjInstance *histogram = createObjectInstance();
+  push(OBJ_VAL(histogram));
+  for(int bucket = 0; bucket < GC_PAUSE_BUCKETS; bucket++) {
+    setInstanceField(histogram, gcPauseBucketName(bucket), NUMBER_VAL((double)stats->pauseHistogram[bucket]));
+  }
+  setInstanceField(instance, "gc_pause_histogram", peek(0));
+  pop(); // histogram
+
+  setInstanceField(instance, "gc_grow_factor", NUMBER_VAL(vm.gcConfig.heapGrowFactor));
+  setInstanceField(instance, "gc_initial_heap", NUMBER_VAL((double)vm.gcConfig.initialHeapSize));
+  setInstanceField(instance, "gc_heap_limit", NUMBER_VAL((double)vm.gcConfig.heapLimit));
+  setInstanceField(instance, "gc_low_memory", BOOL_VAL(vm.gcConfig.lowMemory));
+  setInstanceField(instance, "gc_lazy_sweep", BOOL_VAL(vm.gcConfig.lazySweep));
+  setInstanceField(instance, "gc_mark_threads", NUMBER_VAL((double)vm.gcConfig.markThreads));
+  setInstanceField(instance, "gc_parallel_mark_threshold", NUMBER_VAL((double)vm.gcConfig.parallelMarkThreshold));
   return pop();
-}
\ No newline at end of file
+}
+
+static bool configureGCOption(ObjInstance *options, const char *field, const char *option) {
+  Value value;
+  ObjString *key = copyString(field, strlen(field));
+  if(!tableGet(&options->fields, key, &value)) {
+    return true; // not provided, leave as is
+  }
+  char buffer[32];
+  if(IS_BOOL(value)) {
+    snprintf(buffer, sizeof(buffer), "%s", AS_BOOL(value) ? "true" : "false");
+  } else if(IS_NUMBER(value)) {
+    snprintf(buffer, sizeof(buffer), "%.17g", AS_NUMBER(value));
+  } else {
+    return false;
+  }
+  return setGCOption(option, buffer);
+}
+
+Value configureGCNative(Value *receiver, int argCount, Value *args) {
+  if(argCount != 1) {
+    // runtimeError("configureGC() takes exactly 1 argument (%d given).", argCount);
+    return NIL_VAL;
+  }
+  if(!IS_INSTANCE(args[0])) {
+    // runtimeError("configureGC() argument must be an object.");
+    return NIL_VAL;
+  }
+  ObjInstance *options = AS_INSTANCE(args[0]);
+  bool valid = configureGCOption(options, "growFactor", "grow-factor");
+  valid = configureGCOption(options, "initialHeap", "initial-heap") && valid;
+  valid = configureGCOption(options, "heapLimit", "heap-limit") && valid;
+  valid = configureGCOption(options, "lowMemory", "low-memory") && valid;
+  valid = configureGCOption(options, "lazySweep", "lazy-sweep") && valid;
+  valid = configureGCOption(options, "markThreads", "mark-threads") && valid;
+  valid = configureGCOption(options, "parallelMarkThreshold", "parallel-mark-threshold") && valid;
+  return BOOL_VAL(valid);
+}
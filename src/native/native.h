@@ -17,6 +17,7 @@ Value printMethods(Value *receiver, int argCount, Value *args);
 Value getEnvVarNative(Value *receiver, int argCount, Value *args);
 
 Value getMemStatsNative(Value *receiver, int argCount, Value *args);
+Value configureGCNative(Value *receiver, int argCount, Value *args);
 
 Value evalNative(Value *receiver, int argCount, Value *args);
 
@@ -35,6 +36,9 @@ Value array_filter(Value *receiver, int argCount, Value *args);
 Value array_map(Value *receiver, int argCount, Value *args);
 Value array_foreach(Value *receiver, int argCount, Value *args);
 Value array_slice(Value *receiver, int argCount, Value *args);
+Value array_sort(Value *receiver, int argCount, Value *args);
+Value array_sort_stable(Value *receiver, int argCount, Value *args);
+Value array_binary_search(Value *receiver, int argCount, Value *args);
 
 // Buffer methods
 Value bufferConstructor(Value *receiver, int argCount, Value* args);
@@ -45,12 +49,65 @@ Value buffer_as_array(Value *receiver, int argCount, Value* args);
 Value buffer_as_string(Value *receiver, int argCount, Value* args);
 Value buffer_append(Value *receiver, int argCount, Value* args);
 
+// StringBuilder methods
+Value stringBuilderConstructor(Value *receiver, int argCount, Value* args);
+Value string_builder_length(Value *receiver, int argCount, Value* args);
+Value string_builder_append(Value *receiver, int argCount, Value* args);
+Value string_builder_append_number(Value *receiver, int argCount, Value* args);
+Value string_builder_append_buffer(Value *receiver, int argCount, Value* args);
+Value string_builder_to_string(Value *receiver, int argCount, Value* args);
+Value string_builder_clear(Value *receiver, int argCount, Value* args);
+
+// Map methods
+Value mapConstructor(Value *receiver, int argCount, Value* args);
+Value map_size(Value *receiver, int argCount, Value* args);
+Value map_get(Value *receiver, int argCount, Value* args);
+Value map_set(Value *receiver, int argCount, Value* args);
+Value map_has(Value *receiver, int argCount, Value* args);
+Value map_delete(Value *receiver, int argCount, Value* args);
+Value map_keys(Value *receiver, int argCount, Value* args);
+Value map_values(Value *receiver, int argCount, Value* args);
+Value map_foreach(Value *receiver, int argCount, Value* args);
+
+// Set methods
+Value setConstructor(Value *receiver, int argCount, Value* args);
+Value set_size(Value *receiver, int argCount, Value* args);
+Value set_add(Value *receiver, int argCount, Value* args);
+Value set_has(Value *receiver, int argCount, Value* args);
+Value set_delete(Value *receiver, int argCount, Value* args);
+Value set_values(Value *receiver, int argCount, Value* args);
+Value set_foreach(Value *receiver, int argCount, Value* args);
+Value set_union(Value *receiver, int argCount, Value* args);
+Value set_intersect(Value *receiver, int argCount, Value* args);
+Value set_difference(Value *receiver, int argCount, Value* args);
+
+// Typed array methods
+Value float64ArrayConstructor(Value *receiver, int argCount, Value* args);
+Value int32ArrayConstructor(Value *receiver, int argCount, Value* args);
+Value uint8ArrayConstructor(Value *receiver, int argCount, Value* args);
+Value typed_array_length(Value *receiver, int argCount, Value* args);
+Value typed_array_get(Value *receiver, int argCount, Value* args);
+Value typed_array_set(Value *receiver, int argCount, Value* args);
+Value typed_array_sum(Value *receiver, int argCount, Value* args);
+Value typed_array_mean(Value *receiver, int argCount, Value* args);
+Value typed_array_min(Value *receiver, int argCount, Value* args);
+Value typed_array_max(Value *receiver, int argCount, Value* args);
+Value typed_array_dot(Value *receiver, int argCount, Value* args);
+Value typed_array_scale(Value *receiver, int argCount, Value* args);
+Value typed_array_add(Value *receiver, int argCount, Value* args);
+Value typed_array_fill(Value *receiver, int argCount, Value* args);
+Value typed_array_map(Value *receiver, int argCount, Value* args);
+Value typed_array_to_array(Value *receiver, int argCount, Value* args);
+
 // String methods
 Value string_length(Value *receiver, int argCount, Value* args);
 Value string_get(Value *receiver, int argCount, Value* args);
 Value string_find(Value *receiver, int argCount, Value* args);
+Value string_find_all(Value *receiver, int argCount, Value* args);
+Value string_count(Value *receiver, int argCount, Value* args);
 Value string_substring(Value *receiver, int argCount, Value* args);
 Value string_split(Value *receiver, int argCount, Value* args);
 Value string_replace(Value *receiver, int argCount, Value* args);
+Value string_replace_first(Value *receiver, int argCount, Value* args);
 
 #endif
\ No newline at end of file
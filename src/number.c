@@ -0,0 +1,443 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "number.h"
+
+// Shortest round trip formatting with Grisu3 (Florian Loitsch, "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers"), following
+// Milo Yip's public domain Grisu2 and the double-conversion library's
+// rounding checks.
+
+typedef struct {
+  uint64_t f;
+  int e;
+} DiyFp;
+
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFull
+#define DP_EXPONENT_MASK 0x7FF0000000000000ull
+#define DP_HIDDEN_BIT 0x0010000000000000ull
+#define DP_EXPONENT_BIAS 1075
+
+static DiyFp diyFpFromDouble(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int biasedExponent = (int)((bits & DP_EXPONENT_MASK) >> 52);
+  uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+  DiyFp fp;
+  if (biasedExponent != 0) {
+    fp.f = significand + DP_HIDDEN_BIT;
+    fp.e = biasedExponent - DP_EXPONENT_BIAS;
+  } else {
+    fp.f = significand;
+    fp.e = 1 - DP_EXPONENT_BIAS;
+  }
+  return fp;
+}
+
+// Upper 64 bits of the product, rounded
+static DiyFp diyFpMultiply(DiyFp x, DiyFp y) {
+  const uint64_t mask32 = 0xFFFFFFFF;
+  uint64_t a = x.f >> 32, b = x.f & mask32;
+  uint64_t c = y.f >> 32, d = y.f & mask32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & mask32) + (bc & mask32);
+  tmp += 1U << 31;
+  DiyFp result = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+  return result;
+}
+
+static DiyFp diyFpNormalize(DiyFp x) {
+  while (!(x.f & (1ull << 63))) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+// The neighbours halfway to the next smaller and larger doubles
+static void normalizedBoundaries(DiyFp v, DiyFp* minus, DiyFp* plus) {
+  DiyFp upper = { (v.f << 1) + 1, v.e - 1 };
+  upper = diyFpNormalize(upper);
+  DiyFp lower;
+  if (v.f == DP_HIDDEN_BIT) {
+    lower.f = (v.f << 2) - 1;
+    lower.e = v.e - 2;
+  } else {
+    lower.f = (v.f << 1) - 1;
+    lower.e = v.e - 1;
+  }
+  lower.f <<= lower.e - upper.e;
+  lower.e = upper.e;
+  *minus = lower;
+  *plus = upper;
+}
+
+// 10^k for k = -348, -340, ..., 340
+static const uint64_t cachedPowersF[] = {
+  0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+  0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+  0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+  0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+  0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+  0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+  0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+  0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+  0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+  0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+  0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+  0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+  0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+  0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+  0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+  0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+  0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+  0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+  0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+  0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+  0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+  0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+  0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+  0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+  0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+  0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+  0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+  0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+  0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+};
+
+static const int16_t cachedPowersE[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+  -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+  -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+  -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+  -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+  109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+  641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+  907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static DiyFp cachedPower(int e, int* k) {
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = (int)dk;
+  if (dk - ik > 0.0) ik++;
+  unsigned index = (unsigned)((ik >> 3) + 1);
+  *k = -(-348 + (int)index * 8);
+  DiyFp power = { cachedPowersF[index], cachedPowersE[index] };
+  return power;
+}
+
+static const uint32_t pow10s[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static int countDecimalDigits(uint32_t n) {
+  int digits = 1;
+  while (digits < 10 && n >= pow10s[digits]) digits++;
+  return digits;
+}
+
+// Moves the last digit towards w while that stays inside the safe interval.
+// Fails when the imprecision of the scaled values (unit) means the result
+// might not be the closest, or not even inside the rounding interval.
+static bool roundWeed(char* buffer, int length, uint64_t distanceTooHighW,
+                      uint64_t unsafeInterval, uint64_t rest, uint64_t tenKappa,
+                      uint64_t unit) {
+  uint64_t smallDistance = distanceTooHighW - unit;
+  uint64_t bigDistance = distanceTooHighW + unit;
+  while (rest < smallDistance && unsafeInterval - rest >= tenKappa &&
+         (rest + tenKappa < smallDistance ||
+          smallDistance - rest >= rest + tenKappa - smallDistance)) {
+    buffer[length - 1]--;
+    rest += tenKappa;
+  }
+  if (rest < bigDistance && unsafeInterval - rest >= tenKappa &&
+      (rest + tenKappa < bigDistance ||
+       bigDistance - rest > rest + tenKappa - bigDistance)) {
+    return false;
+  }
+  return 2 * unit <= rest && rest <= unsafeInterval - 4 * unit;
+}
+
+// Generates digits from the top of the interval until the rest would fall
+// inside it. The scaled boundaries are off by up to one unit, so the
+// interval is widened by that much and roundWeed() rejects results that
+// depend on it.
+static bool digitGen(DiyFp low, DiyFp w, DiyFp high, char* buffer,
+                     int* length, int* k) {
+  uint64_t unit = 1;
+  uint64_t tooHigh = high.f + unit;
+  uint64_t unsafeInterval = tooHigh - (low.f - unit);
+  DiyFp one = { 1ull << -w.e, w.e };
+  uint32_t p1 = (uint32_t)(tooHigh >> -one.e);
+  uint64_t p2 = tooHigh & (one.f - 1);
+  int kappa = countDecimalDigits(p1);
+  *length = 0;
+
+  while (kappa > 0) {
+    uint32_t digit = p1 / pow10s[kappa - 1];
+    p1 %= pow10s[kappa - 1];
+    if (digit != 0 || *length != 0) buffer[(*length)++] = (char)('0' + digit);
+    kappa--;
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest < unsafeInterval && *length != 0) {
+      *k += kappa;
+      return roundWeed(buffer, *length, tooHigh - w.f, unsafeInterval, rest,
+                       (uint64_t)pow10s[kappa] << -one.e, unit);
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    unit *= 10;
+    unsafeInterval *= 10;
+    char digit = (char)(p2 >> -one.e);
+    if (digit != 0 || *length != 0) buffer[(*length)++] = (char)('0' + digit);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < unsafeInterval && *length != 0) {
+      *k += kappa;
+      return roundWeed(buffer, *length, (tooHigh - w.f) * unit,
+                       unsafeInterval, p2, one.f, unit);
+    }
+  }
+}
+
+// Writes the shortest digits of a positive value that read back to it and,
+// of those, the ones closest to it, the value being digits * 10^k. Returns
+// 0 for the few values (about 0.5%) where the scaled arithmetic can't
+// decide, see roundWeed().
+static int grisu3(double value, char* digits, int* k) {
+  DiyFp v = diyFpFromDouble(value);
+  DiyFp minus, plus;
+  normalizedBoundaries(v, &minus, &plus);
+
+  DiyFp power = cachedPower(plus.e, k);
+  DiyFp w = diyFpMultiply(diyFpNormalize(v), power);
+  DiyFp upper = diyFpMultiply(plus, power);
+  DiyFp lower = diyFpMultiply(minus, power);
+
+  int length;
+  if (!digitGen(lower, w, upper, digits, &length, k)) return 0;
+  return length;
+}
+
+// The same digits the slow way: the shortest correctly rounded "%.*e" that
+// reads back to value. If some precision reads back so do all larger ones,
+// and 17 significant digits always do, so the precision is binary searched.
+static int shortestDigits(double value, char* digits, int* k) {
+  char buffer[32];
+  int low = 0, high = 16;
+  while (low < high) {
+    int precision = (low + high) / 2;
+    snprintf(buffer, sizeof(buffer), "%.*e", precision, value);
+    if (strtod(buffer, NULL) == value) {
+      high = precision;
+    } else {
+      low = precision + 1;
+    }
+  }
+  snprintf(buffer, sizeof(buffer), "%.*e", high, value);
+  int length = 0;
+  char* c = buffer;
+  for (; *c != 'e'; c++) {
+    if (*c != '.') digits[length++] = *c;
+  }
+  while (length > 1 && digits[length - 1] == '0') length--;
+  *k = atoi(c + 1) - (length - 1);
+  return length;
+}
+
+static int writeExponent(int exponent, char* buffer) {
+  char* start = buffer;
+  *buffer++ = 'e';
+  if (exponent < 0) {
+    *buffer++ = '-';
+    exponent = -exponent;
+  } else {
+    *buffer++ = '+';
+  }
+  if (exponent >= 100) {
+    *buffer++ = (char)('0' + exponent / 100);
+    exponent %= 100;
+    *buffer++ = (char)('0' + exponent / 10);
+  } else if (exponent >= 10) {
+    *buffer++ = (char)('0' + exponent / 10);
+  }
+  *buffer++ = (char)('0' + exponent % 10);
+  return (int)(buffer - start);
+}
+
+// Lays the digits out the way JavaScript does: plain notation for decimal
+// exponents from -6 up to 21, scientific notation outside of that
+static int prettify(const char* digits, int length, int k, char* buffer) {
+  int point = length + k; // position of the decimal point
+  char* out = buffer;
+  if (length <= point && point <= 21) {
+    memcpy(out, digits, length);
+    out += length;
+    for (int i = length; i < point; i++) *out++ = '0';
+  } else if (0 < point && point <= 21) {
+    memcpy(out, digits, point);
+    out += point;
+    *out++ = '.';
+    memcpy(out, digits + point, length - point);
+    out += length - point;
+  } else if (-6 < point && point <= 0) {
+    *out++ = '0';
+    *out++ = '.';
+    for (int i = point; i < 0; i++) *out++ = '0';
+    memcpy(out, digits, length);
+    out += length;
+  } else {
+    *out++ = digits[0];
+    if (length > 1) {
+      *out++ = '.';
+      memcpy(out, digits + 1, length - 1);
+      out += length - 1;
+    }
+    out += writeExponent(point - 1, out);
+  }
+  *out = '\0';
+  return (int)(out - buffer);
+}
+
+static int formatInteger(uint64_t value, char* buffer) {
+  char digits[20];
+  int length = 0;
+  do {
+    digits[length++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  for (int i = 0; i < length; i++) buffer[i] = digits[length - 1 - i];
+  buffer[length] = '\0';
+  return length;
+}
+
+// Formats value with the fewest digits that parse back to the same double,
+// returns the length written to buffer (at least NUMBER_BUFFER_SIZE bytes)
+int formatNumber(double value, char* buffer) {
+  if (isnan(value)) {
+    memcpy(buffer, "nan", 4);
+    return 3;
+  }
+  char* out = buffer;
+  if (signbit(value)) {
+    *out++ = '-';
+    value = -value;
+  }
+  if (isinf(value)) {
+    memcpy(out, "inf", 4);
+    return (int)(out - buffer) + 3;
+  }
+  // Integers are exact below 2^53 and are by far the most common case
+  if (value < 9007199254740992.0 && value == (double)(uint64_t)value) {
+    return (int)(out - buffer) + formatInteger((uint64_t)value, out);
+  }
+
+  char digits[18];
+  int k;
+  int length = grisu3(value, digits, &k);
+#ifdef DEBUG_CHECK_NUMBERS
+  if (length != 0) {
+    char expected[18];
+    int expectedK;
+    int expectedLength = shortestDigits(value, expected, &expectedK);
+    if (length != expectedLength || k != expectedK ||
+        memcmp(digits, expected, length) != 0) {
+      fprintf(stderr, "formatNumber(%.17g): got %.*se%d, expected %.*se%d\n",
+              value, length, digits, k, expectedLength, expected, expectedK);
+      abort();
+    }
+  }
+#endif
+  if (length == 0) length = shortestDigits(value, digits, &k);
+  return (int)(out - buffer) + prettify(digits, length, k, out);
+}
+
+// Powers of ten that are exact doubles
+static const double exactPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static double parseNumberSlow(const char* chars, int length) {
+  char small[64];
+  char* copy = length < (int)sizeof(small) ? small : (char*)malloc(length + 1);
+  if (copy == NULL) return strtod(chars, NULL);
+  memcpy(copy, chars, length);
+  copy[length] = '\0';
+  double value = strtod(copy, NULL);
+  if (copy != small) free(copy);
+  return value;
+}
+
+// Parses a decimal number such as "-12.5e3". When the digits and the power of
+// ten are both exact doubles a single multiply or divide gives the correctly
+// rounded result (Clinger's fast path), anything else goes to strtod().
+double parseNumber(const char* chars, int length) {
+  const char* p = chars;
+  const char* end = chars + length;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+      if (mantissa != 0) digits++;
+    } else {
+      exponent++;
+      digits++;
+    }
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        if (mantissa != 0) digits++;
+        exponent--;
+      } else {
+        digits++;
+      }
+      p++;
+    }
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negativeExponent = *p == '-';
+      p++;
+    }
+    int explicitExponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (explicitExponent < 100000) {
+        explicitExponent = explicitExponent * 10 + (*p - '0');
+      }
+      p++;
+    }
+    exponent += negativeExponent ? -explicitExponent : explicitExponent;
+  }
+
+  if (digits <= 19 && mantissa <= (1ull << 53) &&
+      exponent >= -22 && exponent <= 22) {
+    double value = (double)mantissa;
+    if (exponent < 0) {
+      value /= exactPowersOfTen[-exponent];
+    } else {
+      value *= exactPowersOfTen[exponent];
+    }
+    return negative ? -value : value;
+  }
+  return parseNumberSlow(chars, length);
+}
@@ -0,0 +1,12 @@
+#ifndef clox_number_h
+#define clox_number_h
+
+#include "common.h"
+
+// Large enough for any formatted double, including the terminator
+#define NUMBER_BUFFER_SIZE 32
+
+int formatNumber(double value, char* buffer);
+double parseNumber(const char* chars, int length);
+
+#endif
@@ -1,4 +1,6 @@
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "memory.h"
@@ -17,6 +19,8 @@ static Obj* allocateObject(size_t size, ObjType type) {
 
   object->next = vm.objects;
   vm.objects = object;
+  // Keep new objects out of reach of a pending lazy sweep
+  if (vm.sweepLink == &vm.objects) vm.sweepLink = &object->next;
 
 #ifdef DEBUG_LOG_GC
   printf("%p allocate %zu for %d\n", (void*)object, size, type);
@@ -27,6 +31,7 @@ static Obj* allocateObject(size_t size, ObjType type) {
 
 ObjArray* newArray() {
   ObjArray* array = ALLOCATE_OBJ(ObjArray, OBJ_ARRAY);
+  array->kind = ELEMENTS_NUMBERS;
   initValueArray(&array->values);
   return array;
 }
@@ -77,68 +82,352 @@ ObjInstance* newInstance(ObjClass* klass) {
   return instance;
 }
 
-ObjNative* newNative(NativeFn function, bool callsLox) {
+ObjNative* newNative(NativeFn function) {
   ObjNative* native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
   native->function = function;
-  native->callsLox = callsLox;
   return native;
 }
 
-ObjBoundNative* newBoundNative(Value receiver, NativeFn function, bool callsLox) {
+ObjBoundNative* newBoundNative(Value receiver, NativeFn function) {
   ObjBoundNative* native = ALLOCATE_OBJ(ObjBoundNative, OBJ_BOUND_NATIVE);
   native->function = function;
   native->receiver = receiver;
-  native->callsLox = callsLox;
   return native;
 }
 
-static ObjString* allocateString(char* chars, int length,
-                                 uint32_t hash) {
-  ObjString* string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
+// Longer strings are rarely used as keys, so hashing them up front to intern
+// them doesn't pay off
+#define STRING_INTERN_MAX_LENGTH 256
+
+// Allocates an uninterned string with room for length chars, which the caller
+// fills in. It can be used as is or handed to internString().
+ObjString* allocateString(int length) {
+  ObjString* string = (ObjString*)allocateObject(
+      sizeof(ObjString) + length + 1, OBJ_STRING);
   string->length = length;
+  string->hash = 0;
+  string->hashed = false;
+  string->interned = false;
+  string->isSlice = false;
+  string->chars = string->storage;
+  string->chars[length] = '\0';
+  return string;
+}
+
+// The caller keeps left and right reachable and has checked that their
+// combined length fits in an int, see concatenate()
+ObjString* newRope(ObjString* left, ObjString* right) {
+  ObjString* string = (ObjString*)allocateObject(
+      sizeof(ObjString) + sizeof(RopeParts), OBJ_STRING);
+  string->length = left->length + right->length;
+  string->hash = 0;
+  string->hashed = false;
+  string->interned = false;
+  string->isSlice = false;
+  string->chars = NULL;
+  ROPE_PARTS(string)->left = left;
+  ROPE_PARTS(string)->right = right;
+  return string;
+}
+
+// The characters from start on, which must lie within string. Long results
+// share the characters of string rather than copying them, the caller keeps
+// string reachable and flattened.
+ObjString* sliceString(ObjString* string, int start, int length) {
+  if (length < SLICE_MIN_LENGTH) {
+    return newString(string->chars + start, length);
+  }
+  // Slices of slices share the original characters
+  ObjString* parent = string;
+  if (string->isSlice && SLICE_PARENT(string) != NULL) {
+    parent = SLICE_PARENT(string);
+  }
+  ObjString* slice = (ObjString*)allocateObject(
+      sizeof(ObjString) + sizeof(ObjString*), OBJ_STRING);
+  slice->length = length;
+  slice->hash = 0;
+  slice->hashed = false;
+  slice->interned = false;
+  slice->isSlice = true;
+  slice->chars = string->chars + start;
+  SLICE_PARENT(slice) = parent;
+  return slice;
+}
+
+// Ropes built by s = s + part loops lean left, so the pieces are copied in
+// from the end, which keeps the explicit stack short for them
+void flattenString(ObjString* string) {
+  if (string->chars != NULL) return;
+
+  push(OBJ_VAL(string)); // for garbage collection safety
+  char* chars = ALLOCATE(char, string->length + 1);
+  pop();
+  chars[string->length] = '\0';
+
+  int capacity = 8;
+  int count = 0;
+  ObjString** stack = (ObjString**)malloc(sizeof(ObjString*) * capacity);
+  if (stack == NULL) exit(1);
+  stack[count++] = string;
+  int end = string->length;
+  while (count > 0) {
+    ObjString* node = stack[--count];
+    if (node->chars != NULL) {
+      end -= node->length;
+      memcpy(chars + end, node->chars, node->length);
+      continue;
+    }
+    if (count + 2 > capacity) {
+      capacity = GROW_CAPACITY(capacity);
+      stack = (ObjString**)realloc(stack, sizeof(ObjString*) * capacity);
+      if (stack == NULL) exit(1);
+    }
+    stack[count++] = ROPE_PARTS(node)->left;
+    stack[count++] = ROPE_PARTS(node)->right;
+  }
+  free(stack);
+
+  // The parts are no longer needed and may be collected
   string->chars = chars;
-  string->hash = hash;
+  ROPE_PARTS(string)->left = NULL;
+  ROPE_PARTS(string)->right = NULL;
+}
+
+// Makes chars a null terminated buffer, for code that hands them to C
+void terminateString(ObjString* string) {
+  if (!string->isSlice) {
+    flattenString(string);
+    return;
+  }
+  if (SLICE_PARENT(string) == NULL) return;
 
+  push(OBJ_VAL(string)); // for garbage collection safety
+  char* chars = ALLOCATE(char, string->length + 1);
+  pop();
+  memcpy(chars, string->chars, string->length);
+  chars[string->length] = '\0';
+
+  // The parent is no longer needed and may be collected
+  string->chars = chars;
+  SLICE_PARENT(string) = NULL;
+}
+
+// Prints a rope piece by piece, so printing never allocates from the heap
+void printString(ObjString* string) {
+  if (string->chars != NULL) {
+    printf("%.*s", string->length, string->chars);
+    return;
+  }
+
+  int capacity = 8;
+  int count = 0;
+  ObjString** stack = (ObjString**)malloc(sizeof(ObjString*) * capacity);
+  if (stack == NULL) exit(1);
+  stack[count++] = string;
+  while (count > 0) {
+    ObjString* node = stack[--count];
+    if (node->chars != NULL) {
+      printf("%.*s", node->length, node->chars);
+      continue;
+    }
+    if (count + 2 > capacity) {
+      capacity = GROW_CAPACITY(capacity);
+      stack = (ObjString**)realloc(stack, sizeof(ObjString*) * capacity);
+      if (stack == NULL) exit(1);
+    }
+    stack[count++] = ROPE_PARTS(node)->right;
+    stack[count++] = ROPE_PARTS(node)->left;
+  }
+  free(stack);
+}
+
+static void addString(ObjString* string, uint32_t hash) {
+  string->hash = hash;
+  string->hashed = true;
+  string->interned = true;
   push(OBJ_VAL(string)); // for garbage collection safety
   tableSet(&vm.strings, string, NIL_VAL);
   pop();
+}
 
-  return string;
+// wyhash (public domain, Wang Yi) reading 8 bytes at a time. Byte order only
+// changes which hash a string gets, so the reads don't swap on big endian.
+static const uint64_t wyp0 = 0xa0761d6478bd642full;
+static const uint64_t wyp1 = 0xe7037ed1a0b428dbull;
+static const uint64_t wyp2 = 0x8ebc6af09c88c6e3ull;
+static const uint64_t wyp3 = 0x589965cc75374cc3ull;
+
+// 64x64 -> 128 bit multiply, low half in a and high half in b
+static inline void wyMum(uint64_t* a, uint64_t* b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  // 32 bit targets such as the Pico
+  uint64_t ha = *a >> 32, hb = *b >> 32;
+  uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t carry = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  carry += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
 }
 
-static uint32_t hashString(const char* key, int length) {
-  uint32_t hash = 2166136261u;
-  for (int i = 0; i < length; i++) {
-    hash ^= (uint8_t)key[i];
-    hash *= 16777619;
+static inline uint64_t wyMix(uint64_t a, uint64_t b) {
+  wyMum(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t wyRead8(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint64_t wyRead4(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+uint32_t hashString(const char* key, int length) {
+  const uint8_t* p = (const uint8_t*)key;
+  size_t remaining = (size_t)length;
+  uint64_t seed = wyMix(wyp0, wyp1);
+  uint64_t a, b;
+  if (remaining <= 16) {
+    if (remaining >= 4) {
+      // Two overlapping 4 byte reads from each end cover up to 16 bytes
+      size_t step = (remaining >> 3) << 2;
+      a = (wyRead4(p) << 32) | wyRead4(p + step);
+      b = (wyRead4(p + remaining - 4) << 32) |
+          wyRead4(p + remaining - 4 - step);
+    } else if (remaining > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[remaining >> 1] << 8) |
+          p[remaining - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    if (remaining > 48) {
+      // Three independent lanes keep the multipliers busy on long strings
+      uint64_t seed1 = seed, seed2 = seed;
+      do {
+        seed = wyMix(wyRead8(p) ^ wyp1, wyRead8(p + 8) ^ seed);
+        seed1 = wyMix(wyRead8(p + 16) ^ wyp2, wyRead8(p + 24) ^ seed1);
+        seed2 = wyMix(wyRead8(p + 32) ^ wyp3, wyRead8(p + 40) ^ seed2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (remaining > 16) {
+      seed = wyMix(wyRead8(p) ^ wyp1, wyRead8(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+    a = wyRead8(p + remaining - 16);
+    b = wyRead8(p + remaining - 8);
   }
-  return hash;
+  a ^= wyp1;
+  b ^= seed;
+  wyMum(&a, &b);
+  return (uint32_t)wyMix(a ^ wyp0 ^ (uint64_t)length, b ^ wyp1);
 }
 
-// Assumes ownership of chars
-ObjString* takeString(char* chars, int length) {
-  uint32_t hash = hashString(chars, length);
-  ObjString* interned = tableFindString(&vm.strings, chars, length,
-                                        hash);
-  if (interned != NULL) {
-    FREE_ARRAY(char, chars, length + 1);
-    return interned;
+// Returns the interned copy of a string from allocateString(), the string
+// itself must not be used afterwards
+ObjString* internString(ObjString* string) {
+  if (string->interned) return string;
+  uint32_t hash = stringHash(string);
+  ObjString* interned = tableFindString(&vm.strings, string->chars,
+                                        string->length, hash);
+  if (interned == NULL) {
+    addString(string, hash);
+    return string;
+  }
+
+  // Nothing can refer to the duplicate yet if it is still the newest object
+  if (vm.objects == (Obj*)string) {
+    vm.objects = string->obj.next;
+    if (vm.sweepLink == &string->obj.next) vm.sweepLink = &vm.objects;
+    reallocate(string, sizeof(ObjString) + string->length + 1, 0);
   }
+  return interned;
+}
 
-  return allocateString(chars, length, hash);
+// Assumes ownership of chars, allocated with ALLOCATE(char, length + 1).
+// Strings keep their characters inline, so this copies them and frees the
+// buffer; building into allocateString() avoids the second allocation.
+ObjString* takeString(char* chars, int length) {
+  ObjString* string = copyString(chars, length);
+  FREE_ARRAY(char, chars, length + 1);
+  return string;
 }
 
 // Assumes it cannot take ownership of chars
 ObjString* copyString(const char* chars, int length) {
+  if (length == 1) return charString((uint8_t)chars[0]);
+  if (length > STRING_INTERN_MAX_LENGTH) return newString(chars, length);
+
   uint32_t hash = hashString(chars, length);
   ObjString* interned = tableFindString(&vm.strings, chars, length,
                                         hash);
   if (interned != NULL) return interned;
 
-  char* heapChars = ALLOCATE(char, length + 1);
-  memcpy(heapChars, chars, length);
-  heapChars[length] = '\0';
-  return allocateString(heapChars, length, hash);
+  ObjString* string = allocateString(length);
+  memcpy(string->chars, chars, length);
+  addString(string, hash);
+  return string;
+}
+
+// Scripts that walk a string character by character ask for these all the
+// time, so after the first lookup they bypass the intern table
+ObjString* charString(uint8_t c) {
+  ObjString* string = vm.charStrings[c];
+  if (string != NULL) return string;
+
+  char chars[1] = { (char)c };
+  uint32_t hash = hashString(chars, 1);
+  string = tableFindString(&vm.strings, chars, 1, hash);
+  if (string == NULL) {
+    string = allocateString(1);
+    string->chars[0] = (char)c;
+    addString(string, hash);
+  }
+  vm.charStrings[c] = string;
+  return string;
+}
+
+// A copy of chars for strings built at runtime, not interned unless it is a
+// single character
+ObjString* newString(const char* chars, int length) {
+  if (length == 1) return charString((uint8_t)chars[0]);
+  ObjString* string = allocateString(length);
+  memcpy(string->chars, chars, length);
+  return string;
+}
+
+bool stringsEqual(ObjString* a, ObjString* b) {
+  if (a == b) return true;
+  if (a->length != b->length) return false;
+  // Two interned strings with the same contents would be the same object
+  if (a->interned && b->interned) return false;
+  if (a->hashed && b->hashed && a->hash != b->hash) return false;
+  if (a->chars == NULL || b->chars == NULL) {
+    push(OBJ_VAL(a)); // for garbage collection safety
+    push(OBJ_VAL(b));
+    flattenString(a);
+    flattenString(b);
+    pop();
+    pop();
+  }
+  return memcmp(a->chars, b->chars, a->length) == 0;
 }
 
 ObjRef* newRef(const char *magic, const char *description, void *data, void (*dispose)(void *data)) {
@@ -147,22 +436,172 @@ ObjRef* newRef(const char *magic, const char *description, void *data, void (*di
   ref->description = description;
   ref->data = data;
   ref->dispose = dispose;
+  ref->externalSize = 0;
   return ref;
 }
 
 ObjBuffer* newBuffer(int size) {
   ObjBuffer* buffer = ALLOCATE_OBJ(ObjBuffer, OBJ_BUFFER);
-  buffer->size = size;
+  buffer->size = 0;
+  buffer->isLarge = size >= LARGE_OBJECT_THRESHOLD;
+  buffer->bytes = NULL;
   push(OBJ_VAL(buffer)); // for garbage collection safety
-  buffer->bytes = ALLOCATE(uint8_t, size);
+  if (buffer->isLarge) {
+    buffer->bytes = (uint8_t*)reallocateLarge(NULL, 0, size);
+  } else {
+    buffer->bytes = ALLOCATE(uint8_t, size);
+  }
+  buffer->size = size;
   pop();
   return buffer;
 }
 
+size_t typedArrayElementSize(TypedArrayKind kind) {
+  switch (kind) {
+    case TYPED_FLOAT64: return sizeof(double);
+    case TYPED_INT32: return sizeof(int32_t);
+    case TYPED_UINT8: return sizeof(uint8_t);
+  }
+  return 0;
+}
+
+const char* typedArrayName(TypedArrayKind kind) {
+  switch (kind) {
+    case TYPED_FLOAT64: return "Float64Array";
+    case TYPED_INT32: return "Int32Array";
+    case TYPED_UINT8: return "Uint8Array";
+  }
+  return "TypedArray";
+}
+
+ObjMap* newMap() {
+  ObjMap* map = ALLOCATE_OBJ(ObjMap, OBJ_MAP);
+  initValueTable(&map->table);
+  return map;
+}
+
+ObjSet* newSet() {
+  ObjSet* set = ALLOCATE_OBJ(ObjSet, OBJ_SET);
+  initValueTable(&set->table);
+  return set;
+}
+
+// The elements start out as zero
+ObjTypedArray* newTypedArray(TypedArrayKind kind, int length) {
+  ObjTypedArray* array = ALLOCATE_OBJ(ObjTypedArray, OBJ_TYPED_ARRAY);
+  size_t size = (size_t)length * typedArrayElementSize(kind);
+  array->kind = kind;
+  array->length = 0;
+  array->isLarge = size >= LARGE_OBJECT_THRESHOLD;
+  array->data = NULL;
+  push(OBJ_VAL(array)); // for garbage collection safety
+  if (array->isLarge) {
+    array->data = reallocateLarge(NULL, 0, size);
+  } else {
+    array->data = ALLOCATE(uint8_t, size);
+  }
+  if (size > 0) {
+    memset(array->data, 0, size);
+  }
+  array->length = length;
+  pop();
+  return array;
+}
+
+// Moves the bytes between the regular heap and the large object space as the
+// buffer crosses the threshold. The buffer must be reachable by the GC.
+void resizeBuffer(ObjBuffer* buffer, int size) {
+  bool isLarge = size >= LARGE_OBJECT_THRESHOLD;
+  if (isLarge == buffer->isLarge) {
+    if (isLarge) {
+      buffer->bytes = (uint8_t*)reallocateLarge(buffer->bytes, buffer->size, size);
+    } else {
+      buffer->bytes = (uint8_t*)reallocate(buffer->bytes, buffer->size, size);
+    }
+    buffer->size = size;
+    return;
+  }
+
+  uint8_t* bytes;
+  if (isLarge) {
+    bytes = (uint8_t*)reallocateLarge(NULL, 0, size);
+  } else {
+    bytes = ALLOCATE(uint8_t, size);
+  }
+  memcpy(bytes, buffer->bytes, buffer->size < size ? buffer->size : size);
+  if (buffer->isLarge) {
+    reallocateLarge(buffer->bytes, buffer->size, 0);
+  } else {
+    FREE_ARRAY(uint8_t, buffer->bytes, buffer->size);
+  }
+  buffer->bytes = bytes;
+  buffer->isLarge = isLarge;
+  buffer->size = size;
+}
+
 // Assumes ownership of bytes
+static void resizeStringBuilder(ObjStringBuilder* builder, int capacity) {
+  bool isLarge = capacity >= LARGE_OBJECT_THRESHOLD;
+  char* chars;
+  if (isLarge) {
+    chars = (char*)reallocateLarge(builder->isLarge ? builder->chars : NULL,
+                                   builder->isLarge ? builder->capacity : 0,
+                                   capacity);
+  } else {
+    chars = ALLOCATE(char, capacity);
+  }
+  if (builder->capacity > 0 && (!builder->isLarge || !isLarge)) {
+    memcpy(chars, builder->chars, builder->length + 1);
+    if (builder->isLarge) {
+      reallocateLarge(builder->chars, builder->capacity, 0);
+    } else {
+      FREE_ARRAY(char, builder->chars, builder->capacity);
+    }
+  }
+  builder->chars = chars;
+  builder->capacity = capacity;
+  builder->isLarge = isLarge;
+}
+
+// capacity is a hint, the terminator it leaves room for still has to fit
+// in an int
+ObjStringBuilder* newStringBuilder(int capacity) {
+  ObjStringBuilder* builder = ALLOCATE_OBJ(ObjStringBuilder, OBJ_STRING_BUILDER);
+  builder->length = 0;
+  builder->capacity = 0;
+  builder->isLarge = false;
+  builder->chars = NULL;
+  if (capacity > 0) {
+    push(OBJ_VAL(builder)); // for garbage collection safety
+    resizeStringBuilder(builder, capacity < INT_MAX ? capacity + 1 : INT_MAX);
+    builder->chars[0] = '\0';
+    pop();
+  }
+  return builder;
+}
+
+// Grows the capacity by doubling, so appending n bytes costs O(n) overall.
+// Returns false and leaves the builder as it was when the contents and their
+// terminator would no longer fit in an int. The builder must be reachable by
+// the GC.
+bool stringBuilderAppend(ObjStringBuilder* builder, const char* chars, int length) {
+  int64_t needed = (int64_t)builder->length + length + 1;
+  if (needed > INT_MAX) return false;
+  if (needed > builder->capacity) {
+    int64_t capacity = builder->capacity < 16 ? 16 : builder->capacity;
+    while (capacity < needed) capacity *= 2;
+    resizeStringBuilder(builder, capacity > INT_MAX ? INT_MAX : (int)capacity);
+  }
+  memcpy(builder->chars + builder->length, chars, length);
+  builder->length += length;
+  builder->chars[builder->length] = '\0';
+  return true;
+}
+
 ObjBuffer* takeBuffer(uint8_t* bytes, int size) {
   ObjBuffer* buffer = ALLOCATE_OBJ(ObjBuffer, OBJ_BUFFER);
   buffer->size = size;
+  buffer->isLarge = false;
   buffer->bytes = bytes;
   return buffer;
 }
@@ -175,6 +614,28 @@ ObjUpvalue* newUpvalue(Value* slot) {
   return upvalue;
 }
 
+const char* objTypeName(ObjType type) {
+  switch (type) {
+    case OBJ_BOUND_METHOD: return "bound_method";
+    case OBJ_CLASS: return "class";
+    case OBJ_INSTANCE: return "instance";
+    case OBJ_CLOSURE: return "closure";
+    case OBJ_FUNCTION: return "function";
+    case OBJ_NATIVE: return "native";
+    case OBJ_STRING: return "string";
+    case OBJ_UPVALUE: return "upvalue";
+    case OBJ_ARRAY: return "array";
+    case OBJ_BOUND_NATIVE: return "bound_native";
+    case OBJ_BUFFER: return "buffer";
+    case OBJ_REF: return "ref";
+    case OBJ_STRING_BUILDER: return "string_builder";
+    case OBJ_TYPED_ARRAY: return "typed_array";
+    case OBJ_MAP: return "map";
+    case OBJ_SET: return "set";
+  }
+  return "unknown";
+}
+
 static void printFunction(ObjFunction* function) {
   if (function->name == NULL) {
     printf("<script>");
@@ -230,17 +691,66 @@ void printObject(Value value) {
       printf("<bound native fn>");
       break;
     case OBJ_STRING:
-      printf("%s", AS_CSTRING(value));
+      printString(AS_STRING(value));
       break;
     case OBJ_BUFFER:
       printf("<buffer %d>", AS_BUFFER(value)->size);
       break;
+    case OBJ_STRING_BUILDER:
+      printf("<string builder %d>", AS_STRING_BUILDER(value)->length);
+      break;
     case OBJ_REF:
       printf("<ref %s>", AS_REF(value)->description);
       break;
     case OBJ_UPVALUE:
       printf("upvalue");
       break;
+    case OBJ_MAP: {
+      ValueTable* table = &AS_MAP(value)->table;
+      printf("Map(");
+      bool first = true;
+      for (int i = 0; i < table->entryCount; i++) {
+        ValueEntry* entry = &table->entries[i];
+        if (!entry->live) continue;
+        if (!first) printf(", ");
+        first = false;
+        printValue(entry->key);
+        printf(": ");
+        printValue(entry->value);
+      }
+      printf(")");
+      break;
+    }
+    case OBJ_SET: {
+      ValueTable* table = &AS_SET(value)->table;
+      printf("Set(");
+      bool first = true;
+      for (int i = 0; i < table->entryCount; i++) {
+        ValueEntry* entry = &table->entries[i];
+        if (!entry->live) continue;
+        if (!first) printf(", ");
+        first = false;
+        printValue(entry->key);
+      }
+      printf(")");
+      break;
+    }
+    case OBJ_TYPED_ARRAY: {
+      ObjTypedArray* array = AS_TYPED_ARRAY(value);
+      printf("%s(", typedArrayName(array->kind));
+      for (int i = 0; i < array->length; i++) {
+        switch (array->kind) {
+          case TYPED_FLOAT64: printValue(NUMBER_VAL(((double*)array->data)[i])); break;
+          case TYPED_INT32: printf("%d", ((int32_t*)array->data)[i]); break;
+          case TYPED_UINT8: printf("%d", ((uint8_t*)array->data)[i]); break;
+        }
+        if (i < array->length - 1) {
+          printf(", ");
+        }
+      }
+      printf(")");
+      break;
+    }
     case OBJ_ARRAY:
       printf("Array(");
       for(int i = 0; i < AS_ARRAY(value)->values.count; i++) {
@@ -5,6 +5,7 @@
 #include "chunk.h"
 #include "table.h"
 #include "value.h"
+#include "valuetable.h"
 
 #define OBJ_TYPE(value)        (AS_OBJ(value)->type)
 
@@ -19,6 +20,10 @@
 #define IS_STRING(value)       isObjType(value, OBJ_STRING)
 #define IS_BUFFER(value)       isObjType(value, OBJ_BUFFER)
 #define IS_REF(value)          isObjType(value, OBJ_REF)
+#define IS_STRING_BUILDER(value) isObjType(value, OBJ_STRING_BUILDER)
+#define IS_TYPED_ARRAY(value)  isObjType(value, OBJ_TYPED_ARRAY)
+#define IS_MAP(value)          isObjType(value, OBJ_MAP)
+#define IS_SET(value)          isObjType(value, OBJ_SET)
 
 #define AS_ARRAY(value)        ((ObjArray*)AS_OBJ(value))
 #define AS_BOUND_METHOD(value) ((ObjBoundMethod*)AS_OBJ(value))
@@ -34,6 +39,10 @@
 #define AS_CSTRING(value)      (((ObjString*)AS_OBJ(value))->chars)
 #define AS_BUFFER(value)       ((ObjBuffer*)AS_OBJ(value))
 #define AS_REF(value)          ((ObjRef*)AS_OBJ(value))
+#define AS_STRING_BUILDER(value) ((ObjStringBuilder*)AS_OBJ(value))
+#define AS_TYPED_ARRAY(value)  ((ObjTypedArray*)AS_OBJ(value))
+#define AS_MAP(value)          ((ObjMap*)AS_OBJ(value))
+#define AS_SET(value)          ((ObjSet*)AS_OBJ(value))
 
 typedef enum {
   OBJ_BOUND_METHOD,
@@ -48,8 +57,14 @@ typedef enum {
   OBJ_BOUND_NATIVE,
   OBJ_BUFFER,
   OBJ_REF,
+  OBJ_STRING_BUILDER,
+  OBJ_TYPED_ARRAY,
+  OBJ_MAP,
+  OBJ_SET,
 } ObjType;
 
+#define OBJ_TYPE_COUNT (OBJ_SET + 1)
+
 struct Obj {
   ObjType type;
   bool isMarked;
@@ -69,26 +84,52 @@ typedef Value (*NativeFn)(Value *receiver, int argCount, Value* args);
 typedef struct {
   Obj obj;
   NativeFn function;
-  bool callsLox;
 } ObjNative;
 
 typedef struct {
   Obj obj;
   Value receiver;
   NativeFn function;
-  bool callsLox;
 } ObjBoundNative;
 
 struct ObjString {
   Obj obj;
   int length;
+  uint32_t hash; // only valid once hashed is set, see stringHash()
+  bool hashed;
+  bool interned; // the single copy of these contents in vm.strings
+  bool isSlice; // chars point into a parent string, see sliceString()
+  // The contents, null terminated unless this is a slice. Points at storage
+  // for flat strings, is NULL for a rope until flattenString() gives it a
+  // buffer of its own.
   char* chars;
-  uint32_t hash;
+  char storage[]; // the characters, RopeParts for a rope or a slice's parent
 };
 
+// A rope defers concatenation, it is only copied into one buffer when its
+// contents are needed
+typedef struct {
+  ObjString* left;
+  ObjString* right;
+} RopeParts;
+
+// Shorter concatenations are copied right away
+#define ROPE_MIN_LENGTH 64
+
+// A slice shares the characters of its parent instead of copying them, the
+// parent is kept alive until terminateString() gives the slice its own copy.
+// Shorter substrings are copied right away.
+#define SLICE_MIN_LENGTH 32
+
+#define ROPE_PARTS(string)     ((RopeParts*)(string)->storage)
+#define SLICE_PARENT(string)   (*(ObjString**)(string)->storage)
+#define IS_ROPE(string)        (!(string)->isSlice && \
+                                (string)->chars != (string)->storage)
+
 typedef struct {
   Obj obj;
   int size;
+  bool isLarge; // bytes live in the large object space
   uint8_t* bytes;
 } ObjBuffer;
 
@@ -98,8 +139,17 @@ typedef struct ObjRef {
   const char *description;
   void *data;
   void (*dispose)(void *data);
+  size_t externalSize; // memory held by data, see setRefExternalSize()
 } ObjRef;
 
+typedef struct {
+  Obj obj;
+  int length;
+  int capacity;
+  bool isLarge; // chars live in the large object space
+  char* chars; // null terminated when capacity > 0
+} ObjStringBuilder;
+
 typedef struct ObjUpvalue {
   Obj obj;
   Value* location;
@@ -132,8 +182,48 @@ typedef struct {
   ObjClosure* method;
 } ObjBoundMethod;
 
+typedef enum {
+  TYPED_FLOAT64,
+  TYPED_INT32,
+  TYPED_UINT8,
+} TypedArrayKind;
+
+// A fixed length array of unboxed numbers for the numeric kernels in
+// native-typed-array.c
 typedef struct {
   Obj obj;
+  TypedArrayKind kind;
+  int length;
+  bool isLarge; // data lives in the large object space
+  void* data;
+} ObjTypedArray;
+
+#define TYPED_ARRAY_BYTES(array) \
+    ((size_t)(array)->length * typedArrayElementSize((array)->kind))
+
+// A dictionary keyed by any value, iterated in insertion order
+typedef struct {
+  Obj obj;
+  ValueTable table;
+} ObjMap;
+
+// The members are the keys of the table, the values are unused
+typedef struct {
+  Obj obj;
+  ValueTable table;
+} ObjSet;
+
+// Like V8's elements kinds, arrays remember whether they only ever held
+// numbers. With NAN_BOXING the values of an ELEMENTS_NUMBERS array have the
+// same bits as a double array, so they can be copied into one wholesale.
+typedef enum {
+  ELEMENTS_NUMBERS,
+  ELEMENTS_VALUES,
+} ElementsKind;
+
+typedef struct {
+  Obj obj;
+  ElementsKind kind; // only moves from numbers to values, see writeArray()
   ValueArray values;
 } ObjArray;
 
@@ -145,17 +235,88 @@ ObjInstance* newInstance(ObjClass* klass);
 ObjClosure* newClosure(ObjFunction* function);
 ObjUpvalue* newUpvalue(Value* slot);
 ObjString* copyString(const char* chars, int length);
+ObjString* charString(uint8_t c);
 void printObject(Value value);
 ObjFunction* newFunction();
-ObjNative* newNative(NativeFn function, bool callsLox);
-ObjBoundNative* newBoundNative(Value receiver, NativeFn function, bool callsLox);
+ObjNative* newNative(NativeFn function);
+ObjBoundNative* newBoundNative(Value receiver, NativeFn function);
+ObjString* allocateString(int length);
+ObjString* newRope(ObjString* left, ObjString* right);
+ObjString* sliceString(ObjString* string, int start, int length);
+void flattenString(ObjString* string);
+void terminateString(ObjString* string);
+void printString(ObjString* string);
+ObjString* internString(ObjString* string);
 ObjString* takeString(char* chars, int length);
+ObjString* newString(const char* chars, int length);
+uint32_t hashString(const char* key, int length);
+bool stringsEqual(ObjString* a, ObjString* b);
 ObjBuffer* newBuffer(int size);
 ObjBuffer* takeBuffer(uint8_t* bytes, int size);
+void resizeBuffer(ObjBuffer* buffer, int size);
+ObjStringBuilder* newStringBuilder(int capacity);
+ObjTypedArray* newTypedArray(TypedArrayKind kind, int length);
+size_t typedArrayElementSize(TypedArrayKind kind);
+const char* typedArrayName(TypedArrayKind kind);
+ObjMap* newMap();
+ObjSet* newSet();
+bool stringBuilderAppend(ObjStringBuilder* builder, const char* chars, int length);
 ObjRef* newRef(const char *magic, const char *description, void *data, void (*dispose)(void *data));
+const char* objTypeName(ObjType type);
 
 static inline bool isObjType(Value value, ObjType type) {
   return IS_OBJ(value) && AS_OBJ(value)->type == type;
 }
 
+static inline void writeArray(ObjArray* array, Value value) {
+  if (!IS_NUMBER(value)) array->kind = ELEMENTS_VALUES;
+  writeValueArray(&array->values, value);
+}
+
+static inline void setArrayElement(ObjArray* array, int index, Value value) {
+  if (!IS_NUMBER(value)) array->kind = ELEMENTS_VALUES;
+  array->values.values[index] = value;
+}
+
+static inline double typedArrayElement(ObjTypedArray* array, int index) {
+  switch (array->kind) {
+    case TYPED_FLOAT64: return ((double*)array->data)[index];
+    case TYPED_INT32: return ((int32_t*)array->data)[index];
+    case TYPED_UINT8: return ((uint8_t*)array->data)[index];
+  }
+  return 0;
+}
+
+// Buffers only take whole numbers from 0 to 255, NaN fails every comparison
+static inline bool isByteValue(double value) {
+  return value >= 0 && value <= 255 && value == (double)(int)value;
+}
+
+// Integer elements saturate, NaN stores as 0
+static inline void setTypedArrayElement(ObjTypedArray* array, int index, double value) {
+  switch (array->kind) {
+    case TYPED_FLOAT64:
+      ((double*)array->data)[index] = value;
+      break;
+    case TYPED_INT32:
+      ((int32_t*)array->data)[index] = value != value ? 0 :
+          value <= INT32_MIN ? INT32_MIN :
+          value >= INT32_MAX ? INT32_MAX : (int32_t)value;
+      break;
+    case TYPED_UINT8:
+      ((uint8_t*)array->data)[index] = !(value > 0) ? 0 :
+          value >= 255 ? 255 : (uint8_t)value;
+      break;
+  }
+}
+
+static inline uint32_t stringHash(ObjString* string) {
+  if (!string->hashed) {
+    flattenString(string);
+    string->hash = hashString(string->chars, string->length);
+    string->hashed = true;
+  }
+  return string->hash;
+}
+
 #endif
@@ -7,7 +7,108 @@
 #include "table.h"
 #include "value.h"
 
-#define TABLE_MAX_LOAD 0.75
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define TABLE_MAX_LOAD 0.875
+#define GROUP_SIZE 16
+
+// Full slots hold the low 7 bits of the hash, so they are never negative
+// as signed bytes
+#define CONTROL_EMPTY ((uint8_t)0x80)
+#define CONTROL_DELETED ((uint8_t)0xFE)
+
+#define HASH_FRAGMENT(hash) ((uint8_t)((hash) & 0x7F))
+
+// Each key has a home slot, which also picks the group probing starts from
+static inline uint32_t homeSlot(uint32_t hash, int capacity) {
+  return (hash >> 7) & (uint32_t)(capacity - 1);
+}
+
+// Tables of up to a single group, which is most instance fields and
+// methods, have no control bytes and probe linearly from the home slot
+// instead. With a handful of keys a few pointer comparisons beat setting up
+// a group match. An empty slot there has a NULL key and a nil value, a
+// deleted one a NULL key and true.
+static inline bool isSmallTable(int capacity) {
+  return capacity <= GROUP_SIZE;
+}
+
+static inline int groupCount(int capacity) {
+  return capacity < GROUP_SIZE ? 1 : capacity / GROUP_SIZE;
+}
+
+static inline int controlSize(int capacity) {
+  return isSmallTable(capacity) ? 0 : capacity;
+}
+
+// The entries, the control bytes and the count of deleted slots share one
+// allocation, in that order. Keeping only the entries pointer in Table holds
+// it to 16 bytes, which every instance and class embeds.
+static inline size_t tableSize(int capacity) {
+  return sizeof(Entry) * capacity + controlSize(capacity) + sizeof(int);
+}
+
+static inline uint8_t* controlBytes(Entry* entries, int capacity) {
+  return (uint8_t*)(entries + capacity);
+}
+
+static inline uint8_t* tableControl(Table* table) {
+  return controlBytes(table->entries, table->capacity);
+}
+
+// Deleted slots count towards the load
+static inline int* deletedSlots(Table* table) {
+  return (int*)(tableControl(table) + controlSize(table->capacity));
+}
+
+// Bit i of a mask is set when slot i of the group matches
+#if defined(__SSE2__)
+static inline uint32_t matchFragment(const uint8_t* group, uint8_t fragment) {
+  __m128i control = _mm_loadu_si128((const __m128i*)group);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(control, _mm_shuffle_epi32(
+          _mm_cvtsi32_si128((int)(fragment * 0x01010101u)), 0)));
+}
+
+static inline uint32_t matchEmpty(const uint8_t* group) {
+  return matchFragment(group, CONTROL_EMPTY);
+}
+
+// Empty and deleted are the only control bytes below -1 as signed bytes
+static inline uint32_t matchEmptyOrDeleted(const uint8_t* group) {
+  __m128i control = _mm_loadu_si128((const __m128i*)group);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpgt_epi8(_mm_set1_epi8(-1), control));
+}
+#else
+static inline uint32_t matchFragment(const uint8_t* group, uint8_t fragment) {
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_SIZE; i++) {
+    if (group[i] == fragment) mask |= 1u << i;
+  }
+  return mask;
+}
+
+static inline uint32_t matchEmpty(const uint8_t* group) {
+  return matchFragment(group, CONTROL_EMPTY);
+}
+
+static inline uint32_t matchEmptyOrDeleted(const uint8_t* group) {
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_SIZE; i++) {
+    if (group[i] == CONTROL_EMPTY || group[i] == CONTROL_DELETED) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+#endif
+
+static inline int lowestBit(uint32_t mask) {
+  return __builtin_ctz(mask);
+}
 
 void initTable(Table* table) {
   table->count = 0;
@@ -16,33 +117,119 @@ void initTable(Table* table) {
 }
 
 void freeTable(Table* table) {
-  FREE_ARRAY(Entry, table->entries, table->capacity);
+  if (table->entries != NULL) {
+    reallocate(table->entries, tableSize(table->capacity), 0);
+  }
   initTable(table);
 }
 
-static Entry* findEntry(Entry* entries, int capacity,
-                        ObjString* key) {
-  // uint32_t index = key->hash % capacity;
-  uint32_t index = key->hash & (capacity - 1); // optimization
-  Entry* tombstone = NULL;
+// Keys are compared by identity first, uninterned strings by contents
+static inline bool keysEqual(ObjString* entryKey, ObjString* key,
+                             uint32_t hash) {
+  if (entryKey == key) return true;
+  if (entryKey->interned && key->interned) return false;
+  return entryKey->length == key->length &&
+         entryKey->hash == hash &&
+         memcmp(entryKey->chars, key->chars, key->length) == 0;
+}
 
-  for (;;) {
-    Entry* entry = &entries[index];
-    if (entry->key == NULL) {
-      if (IS_NIL(entry->value)) {
-        // Empty entry.
-        return tombstone != NULL ? tombstone : entry;
-      } else {
-        // We found a tombstone.
-        if (tombstone == NULL) tombstone = entry;
+// Groups are probed triangularly (home, +1, +3, +6, ...), which visits
+// every group of a power of two table before repeating one
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static Entry* findEntryByContents(Table* table, ObjString* key,
+                                  uint32_t hash) {
+  if (isSmallTable(table->capacity)) {
+    uint32_t mask = (uint32_t)table->capacity - 1;
+    for (uint32_t index = homeSlot(hash, table->capacity); ;
+         index = (index + 1) & mask) {
+      Entry* entry = &table->entries[index];
+      if (entry->key == NULL) {
+        if (IS_NIL(entry->value)) return NULL;
+      } else if (keysEqual(entry->key, key, hash)) {
+        return entry;
       }
-    } else if (entry->key == key) {
-      // We found the key.
-      return entry;
     }
+  }
 
-    // index = (index + 1) % capacity;
-    index = (index + 1) & (capacity - 1); // optimization
+  uint32_t groupMask = (uint32_t)groupCount(table->capacity) - 1;
+  uint32_t group = homeSlot(hash, table->capacity) / GROUP_SIZE;
+  uint8_t fragment = HASH_FRAGMENT(hash);
+  for (uint32_t step = 1; ; step++) {
+    const uint8_t* control = tableControl(table) + group * GROUP_SIZE;
+    for (uint32_t matches = matchFragment(control, fragment);
+         matches != 0; matches &= matches - 1) {
+      Entry* entry = &table->entries[group * GROUP_SIZE + lowestBit(matches)];
+      if (keysEqual(entry->key, key, hash)) return entry;
+    }
+    if (matchEmpty(control) != 0) return NULL;
+    group = (group + step) & groupMask;
+  }
+}
+
+// Almost every lookup is an interned key among interned keys, which only
+// needs identity checks. The rest go through findEntryByContents(), kept
+// out of line so this loop has no calls to spill registers around.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static Entry* findEntryInGroups(Table* table, ObjString* key, uint32_t hash) {
+  uint32_t groupMask = (uint32_t)groupCount(table->capacity) - 1;
+  uint32_t group = homeSlot(hash, table->capacity) / GROUP_SIZE;
+  uint8_t fragment = HASH_FRAGMENT(hash);
+  for (uint32_t step = 1; ; step++) {
+    const uint8_t* control = tableControl(table) + group * GROUP_SIZE;
+    for (uint32_t matches = matchFragment(control, fragment);
+         matches != 0; matches &= matches - 1) {
+      Entry* entry = &table->entries[group * GROUP_SIZE + lowestBit(matches)];
+      if (entry->key == key) return entry;
+      if (!entry->key->interned) {
+        return findEntryByContents(table, key, hash);
+      }
+    }
+    if (matchEmpty(control) != 0) return NULL;
+    group = (group + step) & groupMask;
+  }
+}
+
+// Only the small table loop is inlined into the callers, the group probing
+// stays out of line so it doesn't weigh on the common case
+static inline Entry* findEntry(Table* table, ObjString* key, uint32_t hash) {
+  if (!key->interned) return findEntryByContents(table, key, hash);
+  if (!isSmallTable(table->capacity)) {
+    return findEntryInGroups(table, key, hash);
+  }
+
+  uint32_t mask = (uint32_t)table->capacity - 1;
+  for (uint32_t index = homeSlot(hash, table->capacity); ;
+       index = (index + 1) & mask) {
+    Entry* entry = &table->entries[index];
+    if (entry->key == key) return entry;
+    if (entry->key == NULL) {
+      if (IS_NIL(entry->value)) return NULL;
+    } else if (!entry->key->interned) {
+      return findEntryByContents(table, key, hash);
+    }
+  }
+}
+
+static int findInsertSlot(Entry* entries, int capacity, uint32_t hash) {
+  uint32_t home = homeSlot(hash, capacity);
+  if (isSmallTable(capacity)) {
+    uint32_t mask = (uint32_t)capacity - 1;
+    uint32_t index = home;
+    while (entries[index].key != NULL) index = (index + 1) & mask;
+    return (int)index;
+  }
+
+  uint8_t* control = controlBytes(entries, capacity);
+  uint32_t groupMask = (uint32_t)groupCount(capacity) - 1;
+  uint32_t group = home / GROUP_SIZE;
+  for (uint32_t step = 1; ; step++) {
+    uint32_t free = matchEmptyOrDeleted(control + group * GROUP_SIZE);
+    if (free != 0) return group * GROUP_SIZE + lowestBit(free);
+    group = (group + step) & groupMask;
   }
 }
 
@@ -52,7 +239,7 @@ Entry *tableIterate(Table *table, Entry *previous) {
   int startingIndex = previous == NULL ? -1 : (previous - table->entries);
   for(int i = startingIndex + 1; i < table->capacity; i++) {
     Entry *entry = &table->entries[i];
-    // A valid entry that's not a tombstone
+    // A live entry, empty and deleted slots have no key
     if(entry->key != NULL) {
       return entry;
     }
@@ -63,61 +250,146 @@ Entry *tableIterate(Table *table, Entry *previous) {
 bool tableGet(Table* table, ObjString* key, Value* value) {
   if (table->count == 0) return false;
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
-  if (entry->key == NULL) return false;
+  Entry* entry = findEntry(table, key, stringHash(key));
+  if (entry == NULL) return false;
 
   *value = entry->value;
   return true;
 }
 
+// Rehashes into fresh arrays, which also clears the deleted slots
 static void adjustCapacity(Table* table, int capacity) {
-  Entry* entries = ALLOCATE(Entry, capacity);
+  Entry* entries = (Entry*)ALLOCATE(uint8_t, tableSize(capacity));
+  uint8_t* control = controlBytes(entries, capacity);
   for (int i = 0; i < capacity; i++) {
     entries[i].key = NULL;
     entries[i].value = NIL_VAL;
   }
+  memset(control, CONTROL_EMPTY, controlSize(capacity));
 
   table->count = 0;
   for (int i = 0; i < table->capacity; i++) {
     Entry* entry = &table->entries[i];
     if (entry->key == NULL) continue;
 
-    Entry* dest = findEntry(entries, capacity, entry->key);
-    dest->key = entry->key;
-    dest->value = entry->value;
+    int slot = findInsertSlot(entries, capacity, entry->key->hash);
+    if (!isSmallTable(capacity)) control[slot] = HASH_FRAGMENT(entry->key->hash);
+    entries[slot] = *entry;
     table->count++;
   }
 
-  FREE_ARRAY(Entry, table->entries, table->capacity);
+  if (table->entries != NULL) {
+    reallocate(table->entries, tableSize(table->capacity), 0);
+  }
   table->entries = entries;
   table->capacity = capacity;
+  *deletedSlots(table) = 0;
+}
+
+// Finds an interned key in a small table or else the first empty or deleted
+// slot it would be inserted at, in one pass. Returns NULL when the table
+// holds an uninterned key, which needs comparing by contents.
+static Entry* findSmallTableSlot(Table* table, ObjString* key, uint32_t hash) {
+  uint32_t mask = (uint32_t)table->capacity - 1;
+  Entry* tombstone = NULL;
+  for (uint32_t index = homeSlot(hash, table->capacity); ;
+       index = (index + 1) & mask) {
+    Entry* entry = &table->entries[index];
+    if (entry->key == key) return entry;
+    if (entry->key == NULL) {
+      if (IS_NIL(entry->value)) return tombstone != NULL ? tombstone : entry;
+      if (tombstone == NULL) tombstone = entry;
+    } else if (!entry->key->interned) {
+      return NULL;
+    }
+  }
+}
+
+// Deleted slots, unlike empty ones, have a non-nil value
+static inline void insertEntry(Table* table, Entry* entry, ObjString* key,
+                               Value value) {
+  if (!IS_NIL(entry->value)) (*deletedSlots(table))--;
+  entry->key = key;
+  entry->value = value;
+  table->count++;
 }
 
 bool tableSet(Table* table, ObjString* key, Value value) {
-  if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
-    int capacity = GROW_CAPACITY(table->capacity);
+  uint32_t hash = stringHash(key);
+  int deleted = table->capacity == 0 ? 0 : *deletedSlots(table);
+  bool fits = table->count + deleted + 1 <= table->capacity * TABLE_MAX_LOAD;
+
+  if (table->capacity > 0 && isSmallTable(table->capacity) && key->interned) {
+    Entry* entry = findSmallTableSlot(table, key, hash);
+    if (entry != NULL && entry->key == key) {
+      entry->value = value;
+      return false;
+    }
+    if (entry != NULL && fits) {
+      insertEntry(table, entry, key, value);
+      return true;
+    }
+  }
+
+  if (table->count > 0) {
+    Entry* entry = findEntry(table, key, hash);
+    if (entry != NULL) {
+      entry->value = value;
+      return false;
+    }
+  }
+
+  if (!fits) {
+    // Mostly deleted slots can be reclaimed without growing
+    int capacity = table->capacity;
+    if (table->count + 1 > capacity * TABLE_MAX_LOAD / 2) {
+      capacity = GROW_CAPACITY(capacity);
+    }
     adjustCapacity(table, capacity);
   }
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
-  bool isNewKey = entry->key == NULL;
-  if (isNewKey && IS_NIL(entry->value)) table->count++;
+  int slot = findInsertSlot(table->entries, table->capacity, hash);
+  if (!isSmallTable(table->capacity)) {
+    tableControl(table)[slot] = HASH_FRAGMENT(hash);
+  }
+  insertEntry(table, &table->entries[slot], key, value);
+  return true;
+}
 
-  entry->key = key;
-  entry->value = value;
-  return isNewKey;
+// Grows the table so count entries fit without another resize
+void tableReserve(Table* table, int count) {
+  int deleted = table->capacity == 0 ? 0 : *deletedSlots(table);
+  if (count + deleted <= table->capacity * TABLE_MAX_LOAD) return;
+  int capacity = table->capacity < 8 ? 8 : table->capacity;
+  while (count > capacity * TABLE_MAX_LOAD) {
+    capacity *= 2;
+  }
+  adjustCapacity(table, capacity);
 }
 
+// A slot can go straight back to empty when its group still has an empty
+// slot: a group only loses its last empty slot to an insert, so no probe
+// has ever continued past it. Small tables probe slot by slot, so they
+// always leave a deleted slot behind.
 bool tableDelete(Table* table, ObjString* key) {
   if (table->count == 0) return false;
 
-  // Find the entry.
-  Entry* entry = findEntry(table->entries, table->capacity, key);
-  if (entry->key == NULL) return false;
+  Entry* entry = findEntry(table, key, stringHash(key));
+  if (entry == NULL) return false;
 
-  // Place a tombstone in the entry.
   entry->key = NULL;
-  entry->value = BOOL_VAL(true);
+  int slot = (int)(entry - table->entries);
+  uint8_t* control = tableControl(table);
+  if (!isSmallTable(table->capacity) &&
+      matchEmpty(control + (slot & ~(GROUP_SIZE - 1))) != 0) {
+    control[slot] = CONTROL_EMPTY;
+    entry->value = NIL_VAL;
+  } else {
+    if (!isSmallTable(table->capacity)) control[slot] = CONTROL_DELETED;
+    entry->value = BOOL_VAL(true);
+    (*deletedSlots(table))++;
+  }
+  table->count--;
   return true;
 }
 
@@ -134,22 +406,35 @@ ObjString* tableFindString(Table* table, const char* chars,
                            int length, uint32_t hash) {
   if (table->count == 0) return NULL;
 
-  // uint32_t index = hash % table->capacity;
-  uint32_t index = hash & (table->capacity - 1); // optimization
-  for (;;) {
-    Entry* entry = &table->entries[index];
-    if (entry->key == NULL) {
-      // Stop if we find an empty non-tombstone entry.
-      if (IS_NIL(entry->value)) return NULL;
-    } else if (entry->key->length == length &&
-        entry->key->hash == hash &&
-        memcmp(entry->key->chars, chars, length) == 0) {
-      // We found it.
-      return entry->key;
+  if (isSmallTable(table->capacity)) {
+    uint32_t mask = (uint32_t)table->capacity - 1;
+    for (uint32_t index = homeSlot(hash, table->capacity); ;
+         index = (index + 1) & mask) {
+      ObjString* key = table->entries[index].key;
+      if (key == NULL) {
+        if (IS_NIL(table->entries[index].value)) return NULL;
+      } else if (key->length == length && key->hash == hash &&
+                 memcmp(key->chars, chars, length) == 0) {
+        return key;
+      }
     }
+  }
 
-    // index = (index + 1) % table->capacity;
-    index = (index + 1) & (table->capacity - 1); // optimization
+  uint32_t groupMask = (uint32_t)groupCount(table->capacity) - 1;
+  uint32_t group = homeSlot(hash, table->capacity) / GROUP_SIZE;
+  uint8_t fragment = HASH_FRAGMENT(hash);
+  for (uint32_t step = 1; ; step++) {
+    const uint8_t* control = tableControl(table) + group * GROUP_SIZE;
+    for (uint32_t matches = matchFragment(control, fragment);
+         matches != 0; matches &= matches - 1) {
+      ObjString* key = table->entries[group * GROUP_SIZE + lowestBit(matches)].key;
+      if (key->length == length && key->hash == hash &&
+          memcmp(key->chars, chars, length) == 0) {
+        return key;
+      }
+    }
+    if (matchEmpty(control) != 0) return NULL;
+    group = (group + step) & groupMask;
   }
 }
 
@@ -169,3 +454,26 @@ void markTable(Table* table) {
     markValue(entry->value);
   }
 }
+
+// Average and longest number of groups probed past the home group to
+// reach the live keys
+void tableProbeStats(Table* table, double* averageProbe, int* maxProbe) {
+  long totalProbe = 0;
+  int live = 0;
+  *maxProbe = 0;
+  uint32_t groupMask = (uint32_t)groupCount(table->capacity) - 1;
+  for (int i = 0; i < table->capacity; i++) {
+    Entry* entry = &table->entries[i];
+    if (entry->key == NULL) continue;
+    uint32_t group = homeSlot(entry->key->hash, table->capacity) / GROUP_SIZE;
+    int probe = 0;
+    while (group != (uint32_t)i / GROUP_SIZE) {
+      probe++;
+      group = (group + probe) & groupMask;
+    }
+    totalProbe += probe;
+    live++;
+    if (probe > *maxProbe) *maxProbe = probe;
+  }
+  *averageProbe = live == 0 ? 0 : (double)totalProbe / live;
+}
@@ -9,16 +9,23 @@ typedef struct {
   Value value;
 } Entry;
 
+// Swiss table layout: past a single group, besides the entries there is one
+// control byte per slot, holding 7 bits of the key's hash for a full slot
+// or marking it empty or deleted. Lookups compare the control bytes of a 16
+// slot group at once and only look at entries whose hash bits match. Slots
+// that aren't full have a NULL key, so the entries can still be walked
+// directly.
 typedef struct {
-  int count;
+  int count; // live entries
   int capacity;
-  Entry* entries;
+  Entry* entries; // the control bytes follow the entries
 } Table;
 
 void initTable(Table* table);
 void freeTable(Table* table);
 bool tableGet(Table* table, ObjString* key, Value* value);
 bool tableSet(Table* table, ObjString* key, Value value);
+void tableReserve(Table* table, int count);
 bool tableDelete(Table* table, ObjString* key);
 void tableAddAll(Table* from, Table* to);
 ObjString* tableFindString(Table* table, const char* chars,
@@ -26,5 +33,6 @@ ObjString* tableFindString(Table* table, const char* chars,
 void tableRemoveWhite(Table* table);
 void markTable(Table* table);
 Entry *tableIterate(Table *table, Entry *previous);
+void tableProbeStats(Table* table, double* averageProbe, int* maxProbe);
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "object.h"
 #include "memory.h"
+#include "number.h"
 #include "value.h"
 
 void initValueArray(ValueArray* array) {
@@ -14,20 +15,34 @@ void initValueArray(ValueArray* array) {
 void writeValueArray(ValueArray* array, Value value) {
   if (array->capacity < array->count + 1) {
     int oldCapacity = array->capacity;
-    array->capacity = GROW_CAPACITY(oldCapacity);
+    int capacity = GROW_CAPACITY(oldCapacity);
     array->values = GROW_ARRAY(Value, array->values,
-                               oldCapacity, array->capacity);
+                               oldCapacity, capacity);
+    array->capacity = capacity;
   }
 
   array->values[array->count] = value;
   array->count++;
 }
 
+// Grows the capacity to at least count values up front
+void reserveValueArray(ValueArray* array, int count) {
+  if (array->capacity >= count) return;
+  array->values = GROW_ARRAY(Value, array->values, array->capacity, count);
+  array->capacity = count;
+}
+
 void freeValueArray(ValueArray* array) {
   FREE_ARRAY(Value, array->values, array->capacity);
   initValueArray(array);
 }
 
+static void printNumber(double number) {
+  char buffer[NUMBER_BUFFER_SIZE];
+  formatNumber(number, buffer);
+  fputs(buffer, stdout);
+}
+
 void printValue(Value value) {
 #ifdef NAN_BOXING
   if (IS_BOOL(value)) {
@@ -35,7 +50,7 @@ void printValue(Value value) {
   } else if (IS_NIL(value)) {
     printf("nil");
   } else if (IS_NUMBER(value)) {
-    printf("%g", AS_NUMBER(value));
+    printNumber(AS_NUMBER(value));
   } else if (IS_OBJ(value)) {
     printObject(value);
   }
@@ -45,7 +60,7 @@ void printValue(Value value) {
       printf(AS_BOOL(value) ? "true" : "false");
       break;
     case VAL_NIL: printf("nil"); break;
-    case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
+    case VAL_NUMBER: printNumber(AS_NUMBER(value)); break;
     case VAL_OBJ: printObject(value); break;
   }
 #endif
@@ -56,6 +71,9 @@ bool valuesEqual(Value a, Value b) {
   if (IS_NUMBER(a) && IS_NUMBER(b)) {
     return AS_NUMBER(a) == AS_NUMBER(b);
   }
+  if (a != b && IS_STRING(a) && IS_STRING(b)) {
+    return stringsEqual(AS_STRING(a), AS_STRING(b));
+  }
   return a == b;
 #else
   if (a.type != b.type) return false;
@@ -63,7 +81,11 @@ bool valuesEqual(Value a, Value b) {
     case VAL_BOOL:   return AS_BOOL(a) == AS_BOOL(b);
     case VAL_NIL:    return true;
     case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
-    case VAL_OBJ:    return AS_OBJ(a) == AS_OBJ(b);
+    case VAL_OBJ:
+      if (IS_STRING(a) && IS_STRING(b)) {
+        return stringsEqual(AS_STRING(a), AS_STRING(b));
+      }
+      return AS_OBJ(a) == AS_OBJ(b);
     default:         return false; // Unreachable.
   }
 #endif
@@ -98,6 +98,7 @@ typedef struct {
 bool valuesEqual(Value a, Value b);
 void initValueArray(ValueArray* array);
 void writeValueArray(ValueArray* array, Value value);
+void reserveValueArray(ValueArray* array, int count);
 void freeValueArray(ValueArray* array);
 void printValue(Value value);
 
@@ -0,0 +1,223 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "object.h"
+#include "valuetable.h"
+#include "value.h"
+
+#define VALUE_TABLE_MAX_LOAD 0.75
+#define INDEX_EMPTY -1
+#define INDEX_DELETED -2
+
+void initValueTable(ValueTable* table) {
+  table->count = 0;
+  table->entryCount = 0;
+  table->entryCapacity = 0;
+  table->entries = NULL;
+  table->indexCapacity = 0;
+  table->index = NULL;
+}
+
+void freeValueTable(ValueTable* table) {
+  FREE_ARRAY(ValueEntry, table->entries, table->entryCapacity);
+  FREE_ARRAY(int32_t, table->index, table->indexCapacity);
+  initValueTable(table);
+}
+
+static inline uint32_t mixHash(uint64_t bits) {
+  bits ^= bits >> 33;
+  bits *= 0xff51afd7ed558ccdULL;
+  bits ^= bits >> 33;
+  return (uint32_t)bits;
+}
+
+// Numbers hash by their bits, with -0 folded into 0 and every NaN into one
+// so that keys which compare equal land together. Strings hash by their
+// contents and other objects by identity.
+static uint32_t hashValue(Value value) {
+  if (IS_STRING(value)) {
+    return stringHash(AS_STRING(value));
+  }
+  if (IS_NUMBER(value)) {
+    double number = AS_NUMBER(value);
+    if (number == 0) number = 0;
+    if (number != number) number = NAN;
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return mixHash(bits);
+  }
+  if (IS_OBJ(value)) {
+    return mixHash((uint64_t)(uintptr_t)AS_OBJ(value));
+  }
+  if (IS_BOOL(value)) {
+    return AS_BOOL(value) ? 1 : 2;
+  }
+  return 3;
+}
+
+// Like valuesEqual, except that NaN is equal to itself so it can be found
+static inline bool keysEqual(Value a, Value b) {
+  if (IS_NUMBER(a) && IS_NUMBER(b)) {
+    double x = AS_NUMBER(a);
+    double y = AS_NUMBER(b);
+    return x == y || (x != x && y != y);
+  }
+  return valuesEqual(a, b);
+}
+
+// Returns the index slot holding the key, or the slot it would go in
+static int32_t* findSlot(ValueTable* table, Value key, uint32_t hash) {
+  uint32_t mask = (uint32_t)table->indexCapacity - 1;
+  uint32_t slot = hash & mask;
+  int32_t* tombstone = NULL;
+  for (;;) {
+    int32_t* position = &table->index[slot];
+    if (*position == INDEX_EMPTY) {
+      return tombstone != NULL ? tombstone : position;
+    }
+    if (*position == INDEX_DELETED) {
+      if (tombstone == NULL) tombstone = position;
+    } else {
+      ValueEntry* entry = &table->entries[*position];
+      if (entry->hash == hash && keysEqual(entry->key, key)) {
+        return position;
+      }
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+// Squeezes out deleted entries and rebuilds the index with room for
+// at least one more entry
+static void rebuild(ValueTable* table) {
+  int live = 0;
+  for (int i = 0; i < table->entryCount; i++) {
+    if (table->entries[i].live) {
+      table->entries[live++] = table->entries[i];
+    }
+  }
+  table->entryCount = live;
+
+  int capacity = 8;
+  while (live + 1 > capacity * VALUE_TABLE_MAX_LOAD) {
+    capacity *= 2;
+  }
+  if (capacity != table->indexCapacity) {
+    int32_t* index = ALLOCATE(int32_t, capacity);
+    FREE_ARRAY(int32_t, table->index, table->indexCapacity);
+    table->index = index;
+    table->indexCapacity = capacity;
+  }
+  for (int i = 0; i < capacity; i++) {
+    table->index[i] = INDEX_EMPTY;
+  }
+  uint32_t mask = (uint32_t)capacity - 1;
+  for (int i = 0; i < live; i++) {
+    uint32_t slot = table->entries[i].hash & mask;
+    while (table->index[slot] != INDEX_EMPTY) {
+      slot = (slot + 1) & mask;
+    }
+    table->index[slot] = i;
+  }
+}
+
+bool valueTableGet(ValueTable* table, Value key, Value* value) {
+  if (table->count == 0) return false;
+
+  int32_t* position = findSlot(table, key, hashValue(key));
+  if (*position < 0) return false;
+
+  *value = table->entries[*position].value;
+  return true;
+}
+
+static inline bool containsHashed(ValueTable* table, Value key, uint32_t hash) {
+  return table->count > 0 && *findSlot(table, key, hash) >= 0;
+}
+
+// Every entry ever added has taken an index slot, so the load is checked
+// against entryCount. That way deleted slots are reclaimed by rebuild().
+static bool setHashed(ValueTable* table, Value key, Value value, uint32_t hash) {
+  if (table->indexCapacity > 0) {
+    int32_t* position = findSlot(table, key, hash);
+    if (*position >= 0) {
+      table->entries[*position].value = value;
+      return false;
+    }
+  }
+
+  if (table->entryCount + 1 > table->indexCapacity * VALUE_TABLE_MAX_LOAD) {
+    rebuild(table);
+  }
+  if (table->entryCount == table->entryCapacity) {
+    int capacity = GROW_CAPACITY(table->entryCapacity);
+    table->entries = GROW_ARRAY(ValueEntry, table->entries,
+                                table->entryCapacity, capacity);
+    table->entryCapacity = capacity;
+  }
+
+  int32_t* position = findSlot(table, key, hash);
+  ValueEntry* entry = &table->entries[table->entryCount];
+  entry->key = key;
+  entry->value = value;
+  entry->hash = hash;
+  entry->live = true;
+  *position = table->entryCount++;
+  table->count++;
+  return true;
+}
+
+bool valueTableSet(ValueTable* table, Value key, Value value) {
+  return setHashed(table, key, value, hashValue(key));
+}
+
+bool valueTableDelete(ValueTable* table, Value key) {
+  if (table->count == 0) return false;
+
+  int32_t* position = findSlot(table, key, hashValue(key));
+  if (*position < 0) return false;
+
+  ValueEntry* entry = &table->entries[*position];
+  entry->live = false;
+  entry->key = NIL_VAL;
+  entry->value = NIL_VAL;
+  *position = INDEX_DELETED;
+  table->count--;
+  return true;
+}
+
+void markValueTable(ValueTable* table) {
+  for (int i = 0; i < table->entryCount; i++) {
+    ValueEntry* entry = &table->entries[i];
+    if (entry->live) {
+      markValue(entry->key);
+      markValue(entry->value);
+    }
+  }
+}
+
+// The bulk operations reuse the stored hashes instead of hashing again
+
+void valueTableAddAll(ValueTable* from, ValueTable* to) {
+  for (int i = 0; i < from->entryCount; i++) {
+    ValueEntry* entry = &from->entries[i];
+    if (entry->live) {
+      setHashed(to, entry->key, entry->value, entry->hash);
+    }
+  }
+}
+
+// Adds the entries of from whose key is (or with keep false, isn't) in
+// filter, in from's order
+void valueTableAddFiltered(ValueTable* from, ValueTable* filter, bool keep,
+                           ValueTable* to) {
+  for (int i = 0; i < from->entryCount; i++) {
+    ValueEntry* entry = &from->entries[i];
+    if (entry->live &&
+        containsHashed(filter, entry->key, entry->hash) == keep) {
+      setHashed(to, entry->key, entry->value, entry->hash);
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef clox_valuetable_h
+#define clox_valuetable_h
+
+#include "common.h"
+#include "value.h"
+
+// A hash table keyed by any value that remembers insertion order. Entries
+// are appended to an array and a separate open addressed index of entry
+// positions is probed, so iterating is a walk over the entries. Deleted
+// entries leave gaps that are squeezed out the next time the index grows.
+typedef struct {
+  Value key;
+  Value value;
+  uint32_t hash;
+  bool live;
+} ValueEntry;
+
+typedef struct {
+  int count; // live entries
+  int entryCount; // used entries, including deleted ones
+  int entryCapacity;
+  ValueEntry* entries;
+  int indexCapacity; // a power of two
+  int32_t* index;
+} ValueTable;
+
+void initValueTable(ValueTable* table);
+void freeValueTable(ValueTable* table);
+bool valueTableGet(ValueTable* table, Value key, Value* value);
+bool valueTableSet(ValueTable* table, Value key, Value value);
+bool valueTableDelete(ValueTable* table, Value key);
+void valueTableAddAll(ValueTable* from, ValueTable* to);
+void valueTableAddFiltered(ValueTable* from, ValueTable* filter, bool keep,
+                           ValueTable* to);
+void markValueTable(ValueTable* table);
+
+#endif
@@ -10,13 +10,29 @@
 #include "debug.h"
 #include "object.h"
 #include "memory.h"
+#include "number.h"
 #include "vm.h"
 #include "native/native.h"
 #include "modules.h"
 
 VM vm;
 static bool call(ObjClosure* closure, int argCount);
+// Natives read string contents directly, so ropes are flattened on the way
+// in. String methods go by length, other natives may pass chars on to C and
+// get their slices null terminated.
+static void flattenNativeArgs(Value* receiver, int argCount) {
+  void (*prepare)(ObjString*) = terminateString;
+  if (receiver != NULL && IS_STRING(*receiver)) {
+    prepare = flattenString;
+    flattenString(AS_STRING(*receiver));
+  }
+  for (Value* arg = vm.stackTop - argCount; arg < vm.stackTop; arg++) {
+    if (IS_STRING(*arg)) prepare(AS_STRING(*arg));
+  }
+}
+
 static bool callValue(Value callee, int argCount);
+static InterpretResult run(int baseFrame);
 
 ObjInstance *createObjectInstance() {
   Value objClassVal;
@@ -28,48 +44,6 @@ ObjInstance *createObjectInstance() {
   return instance;
 }
 
-Value callLoxCode(const char* name, Value *receiver, int argCount, Value *args) {
-  ObjString *key = copyString(name, (int)strlen(name));
-  Value fn;
-  if(!tableGet(&vm.globals, key, &fn)) {
-    // runtimeError("Could not find function '%s'.", fnName);
-    return NIL_VAL;
-  }
-  if (!IS_CLOSURE(fn)) {
-    // runtimeError("Function '%s' is not a closure.", fnName);
-    return NIL_VAL;
-  }
-
-  // Shift the args over one to make room for the receiver
-  Value newArgs[argCount + 1];
-  newArgs[0] = *receiver;
-  for (int i = 0; i < argCount; i++) {
-    newArgs[i + 1] = args[i];
-  }
-
-  for (int i = 0; i < argCount; i++) {
-    pop(); // pop the args off
-  }
-  pop(); // pop the existing function off
-
-  // Push the new function and args on
-  push(fn);
-  for (int i = 0; i < argCount + 1; i++) {
-    push(newArgs[i]);
-  }
-  callValue(fn, argCount + 1);
-  return NIL_VAL;
-}
-
-static ObjString* getBoundNativeFnName(ObjType type, const char* name) {
-  char typeString[8];
-  sprintf(typeString, "%d.", type);
-  push(OBJ_VAL(copyString(typeString, (int)strlen(typeString))));
-  push(OBJ_VAL(copyString(name, (int)strlen(name))));
-  concatenate();
-  return AS_STRING(pop());
-}
-
 static void resetStack() {
   vm.stackTop = vm.stack;
   vm.frameCount = 0;
@@ -97,37 +71,32 @@ static void runtimeError(const char* format, ...) {
   }
 
   resetStack();
+  vm.hadRuntimeError = true;
 }
 
-static void defineNative(const char* name, NativeFn function, bool callsLox) {
+static void defineNative(const char* name, NativeFn function) {
   // garbage collection care
   push(OBJ_VAL(copyString(name, (int)strlen(name))));
-  push(OBJ_VAL(newNative(function, callsLox)));
+  push(OBJ_VAL(newNative(function)));
   tableSet(&vm.globals, AS_STRING(vm.stack[0]), vm.stack[1]);
   pop();
   pop();
 }
 
-static void defineBoundNativeMethod(ObjType type, const char* name, NativeFn function, bool callsLox) {
-  ObjString *key = getBoundNativeFnName(type, name);
-  push(OBJ_VAL(key));
-  push(OBJ_VAL(newNative(function, callsLox)));
-  tableSet(&vm.globals, AS_STRING(vm.stack[0]), vm.stack[1]);
+static void defineBoundNativeMethod(ObjType type, const char* name, NativeFn function) {
+  push(OBJ_VAL(copyString(name, (int)strlen(name))));
+  push(OBJ_VAL(newNative(function)));
+  tableSet(&vm.nativeMethods[type], AS_STRING(vm.stack[0]), vm.stack[1]);
   pop();
   pop();
 }
 
 void initVM() {
   resetStack();
+  vm.hadRuntimeError = false;
   vm.objects = NULL;
 
-  vm.bytesAllocated = 0;
-  #ifdef PICO_MODULE
-  vm.nextGC = 1024;
-  #else
-  vm.nextGC = 1024 * 1024;
-  #endif
-  vm.debug_maxTotalAllocated = 0;
+  initGC();
 
   vm.grayCount = 0;
   vm.grayCapacity = 0;
@@ -147,58 +116,119 @@ void initVM() {
 
   initTable(&vm.globals);
   initTable(&vm.strings);
+  for (int type = 0; type < OBJ_TYPE_COUNT; type++) {
+    initTable(&vm.nativeMethods[type]);
+  }
 
   vm.initString = NULL;
+  memset(vm.charStrings, 0, sizeof(vm.charStrings));
   vm.initString = copyString("init", 4);
 
-  defineNative("clock", clockNative, false);
-  defineNative("randN", randNNative, false);
-  defineNative("parse", parseJsonNative, false);
-  defineNative("stringify", stringifyJsonNative, false);
-  defineNative("scanToEOF", scanToEOF, false);
-  defineNative("log", printNative, false);
-  defineNative("logln", printlnNative, false);
-  defineNative("printMethods", printMethods, false);
-  defineNative("getInstanceFields", getInstanceFields, false);
-  defineNative("instanceHasFieldValueByKey", instanceHasFieldValueByKey, false);
-  defineNative("getInstanceFieldValueByKey", getInstanceFieldValueByKey, false);
-  defineNative("setInstanceFieldValueByKey", setInstanceFieldValueByKey, false);
-  defineNative("getEnvVar", getEnvVarNative, false);
-  defineNative("getMemStats", getMemStatsNative, false);
-  defineNative("eval", evalNative, true);
-
-  defineNative("systemImport", systemImportNative, true);
-
-  defineNative("Array", array, false);
-  defineBoundNativeMethod(OBJ_ARRAY, "count", array_count, false);
-  defineBoundNativeMethod(OBJ_ARRAY, "push", array_push, false);
-  defineBoundNativeMethod(OBJ_ARRAY, "get", array_get, false);
-  defineBoundNativeMethod(OBJ_ARRAY, "pop", array_pop, false);
-  defineBoundNativeMethod(OBJ_ARRAY, "filter", array_filter, true);
-  defineBoundNativeMethod(OBJ_ARRAY, "map", array_map, true);
-  defineBoundNativeMethod(OBJ_ARRAY, "forEach", array_foreach, true);
-  defineBoundNativeMethod(OBJ_ARRAY, "slice", array_slice, true);
-
-  defineNative("Buffer", bufferConstructor, false);
-  defineBoundNativeMethod(OBJ_BUFFER, "length", buffer_length, false);
-  defineBoundNativeMethod(OBJ_BUFFER, "get", buffer_get, false);
-  defineBoundNativeMethod(OBJ_BUFFER, "set", buffer_set, false);
-  defineBoundNativeMethod(OBJ_BUFFER, "asArray", buffer_as_array, false);
-  defineBoundNativeMethod(OBJ_BUFFER, "asString", buffer_as_string, false);
-  defineBoundNativeMethod(OBJ_BUFFER, "append", buffer_append, false);
-
-  defineBoundNativeMethod(OBJ_STRING, "length", string_length, false);
-  defineBoundNativeMethod(OBJ_STRING, "get", string_get, false);
-  defineBoundNativeMethod(OBJ_STRING, "find", string_find, false);
-  defineBoundNativeMethod(OBJ_STRING, "substring", string_substring, false);
-  defineBoundNativeMethod(OBJ_STRING, "split", string_split, false);
-  defineBoundNativeMethod(OBJ_STRING, "replace", string_replace, true);
+  defineNative("clock", clockNative);
+  defineNative("randN", randNNative);
+  defineNative("parse", parseJsonNative);
+  defineNative("stringify", stringifyJsonNative);
+  defineNative("scanToEOF", scanToEOF);
+  defineNative("log", printNative);
+  defineNative("logln", printlnNative);
+  defineNative("printMethods", printMethods);
+  defineNative("getInstanceFields", getInstanceFields);
+  defineNative("instanceHasFieldValueByKey", instanceHasFieldValueByKey);
+  defineNative("getInstanceFieldValueByKey", getInstanceFieldValueByKey);
+  defineNative("setInstanceFieldValueByKey", setInstanceFieldValueByKey);
+  defineNative("getEnvVar", getEnvVarNative);
+  defineNative("getMemStats", getMemStatsNative);
+  defineNative("configureGC", configureGCNative);
+  defineNative("eval", evalNative);
+
+  defineNative("systemImport", systemImportNative);
+
+  defineNative("Array", array);
+  defineBoundNativeMethod(OBJ_ARRAY, "count", array_count);
+  defineBoundNativeMethod(OBJ_ARRAY, "push", array_push);
+  defineBoundNativeMethod(OBJ_ARRAY, "get", array_get);
+  defineBoundNativeMethod(OBJ_ARRAY, "pop", array_pop);
+  defineBoundNativeMethod(OBJ_ARRAY, "filter", array_filter);
+  defineBoundNativeMethod(OBJ_ARRAY, "map", array_map);
+  defineBoundNativeMethod(OBJ_ARRAY, "forEach", array_foreach);
+  defineBoundNativeMethod(OBJ_ARRAY, "slice", array_slice);
+  defineBoundNativeMethod(OBJ_ARRAY, "sort", array_sort);
+  defineBoundNativeMethod(OBJ_ARRAY, "sortStable", array_sort_stable);
+  defineBoundNativeMethod(OBJ_ARRAY, "binarySearch", array_binary_search);
+
+  defineNative("Buffer", bufferConstructor);
+  defineBoundNativeMethod(OBJ_BUFFER, "length", buffer_length);
+  defineBoundNativeMethod(OBJ_BUFFER, "get", buffer_get);
+  defineBoundNativeMethod(OBJ_BUFFER, "set", buffer_set);
+  defineBoundNativeMethod(OBJ_BUFFER, "asArray", buffer_as_array);
+  defineBoundNativeMethod(OBJ_BUFFER, "asString", buffer_as_string);
+  defineBoundNativeMethod(OBJ_BUFFER, "append", buffer_append);
+
+  defineNative("StringBuilder", stringBuilderConstructor);
+  defineBoundNativeMethod(OBJ_STRING_BUILDER, "length", string_builder_length);
+  defineBoundNativeMethod(OBJ_STRING_BUILDER, "append", string_builder_append);
+  defineBoundNativeMethod(OBJ_STRING_BUILDER, "appendNumber", string_builder_append_number);
+  defineBoundNativeMethod(OBJ_STRING_BUILDER, "appendBuffer", string_builder_append_buffer);
+  defineBoundNativeMethod(OBJ_STRING_BUILDER, "toString", string_builder_to_string);
+  defineBoundNativeMethod(OBJ_STRING_BUILDER, "clear", string_builder_clear);
+
+  defineNative("Map", mapConstructor);
+  defineBoundNativeMethod(OBJ_MAP, "size", map_size);
+  defineBoundNativeMethod(OBJ_MAP, "get", map_get);
+  defineBoundNativeMethod(OBJ_MAP, "set", map_set);
+  defineBoundNativeMethod(OBJ_MAP, "has", map_has);
+  defineBoundNativeMethod(OBJ_MAP, "delete", map_delete);
+  defineBoundNativeMethod(OBJ_MAP, "keys", map_keys);
+  defineBoundNativeMethod(OBJ_MAP, "values", map_values);
+  defineBoundNativeMethod(OBJ_MAP, "forEach", map_foreach);
+
+  defineNative("Set", setConstructor);
+  defineBoundNativeMethod(OBJ_SET, "size", set_size);
+  defineBoundNativeMethod(OBJ_SET, "add", set_add);
+  defineBoundNativeMethod(OBJ_SET, "has", set_has);
+  defineBoundNativeMethod(OBJ_SET, "delete", set_delete);
+  defineBoundNativeMethod(OBJ_SET, "values", set_values);
+  defineBoundNativeMethod(OBJ_SET, "forEach", set_foreach);
+  defineBoundNativeMethod(OBJ_SET, "union", set_union);
+  defineBoundNativeMethod(OBJ_SET, "intersect", set_intersect);
+  defineBoundNativeMethod(OBJ_SET, "difference", set_difference);
+
+  defineNative("Float64Array", float64ArrayConstructor);
+  defineNative("Int32Array", int32ArrayConstructor);
+  defineNative("Uint8Array", uint8ArrayConstructor);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "length", typed_array_length);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "get", typed_array_get);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "set", typed_array_set);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "sum", typed_array_sum);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "mean", typed_array_mean);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "min", typed_array_min);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "max", typed_array_max);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "dot", typed_array_dot);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "scale", typed_array_scale);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "add", typed_array_add);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "fill", typed_array_fill);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "map", typed_array_map);
+  defineBoundNativeMethod(OBJ_TYPED_ARRAY, "toArray", typed_array_to_array);
+
+  defineBoundNativeMethod(OBJ_STRING, "length", string_length);
+  defineBoundNativeMethod(OBJ_STRING, "get", string_get);
+  defineBoundNativeMethod(OBJ_STRING, "find", string_find);
+  defineBoundNativeMethod(OBJ_STRING, "findAll", string_find_all);
+  defineBoundNativeMethod(OBJ_STRING, "count", string_count);
+  defineBoundNativeMethod(OBJ_STRING, "substring", string_substring);
+  defineBoundNativeMethod(OBJ_STRING, "split", string_split);
+  defineBoundNativeMethod(OBJ_STRING, "replace", string_replace);
+  defineBoundNativeMethod(OBJ_STRING, "replaceFirst", string_replace_first);
 }
 
 void freeVM() {
   freeTable(&vm.globals);
   freeTable(&vm.strings);
+  for (int type = 0; type < OBJ_TYPE_COUNT; type++) {
+    freeTable(&vm.nativeMethods[type]);
+  }
   vm.initString = NULL;
+  memset(vm.charStrings, 0, sizeof(vm.charStrings));
   freeObjects();
 
   freeNativeModules();
@@ -237,8 +267,22 @@ static bool call(ObjClosure* closure, int argCount) {
   return true;
 }
 
-bool callModule(ObjClosure *closure, int argCount) {
-  return call(closure, argCount);
+// Calls callee from a native and runs it to completion, storing what it
+// returns in result. Returns false after a runtime error, which has already
+// been reported and has unwound the VM, the native should return right away.
+bool vmCall(Value callee, int argCount, Value* args, Value* result) {
+  int baseFrame = vm.frameCount;
+  vm.hadRuntimeError = false;
+  push(callee);
+  for (int i = 0; i < argCount; i++) {
+    push(args[i]);
+  }
+  if (!callValue(callee, argCount)) return false;
+  if (vm.frameCount > baseFrame && run(baseFrame) != INTERPRET_OK) {
+    return false;
+  }
+  *result = pop();
+  return true;
 }
 
 static bool callValue(Value callee, int argCount) {
@@ -267,20 +311,21 @@ static bool callValue(Value callee, int argCount) {
         return call(AS_CLOSURE(callee), argCount);
       case OBJ_NATIVE: {
         NativeFn native = AS_NATIVE(callee);
+        flattenNativeArgs(NULL, argCount);
         Value result = native(NULL, argCount, vm.stackTop - argCount);
-        if(!((ObjNative*)AS_OBJ(callee))->callsLox) {
-          vm.stackTop -= argCount + 1;
-          push(result);
-        }
+        // A runtime error in a callback has already unwound the VM
+        if (vm.hadRuntimeError) return false;
+        vm.stackTop -= argCount + 1;
+        push(result);
         return true;
       }
       case OBJ_BOUND_NATIVE: {
         ObjBoundNative *native = AS_BOUND_NATIVE(callee);
+        flattenNativeArgs(&native->receiver, argCount);
         Value result = native->function(&native->receiver, argCount, vm.stackTop - argCount);
-        if(!((ObjBoundNative*)AS_OBJ(callee))->callsLox) {
-          vm.stackTop -= argCount + 1;
-          push(result);
-        }
+        if (vm.hadRuntimeError) return false;
+        vm.stackTop -= argCount + 1;
+        push(result);
         return true;
       }
       default:
@@ -307,14 +352,18 @@ static bool invokeFromClass(ObjClass* klass, ObjString* name,
 static bool invoke(ObjString* name, int argCount) {
   Value receiver = peek(argCount);
 
-  // Handle native methods
+  // Handle native methods, called in place with the receiver's stack slot
+  // so no bound native has to be allocated
   if(!IS_INSTANCE(receiver) && IS_OBJ(receiver)) {
     Value value;
-    ObjString *key = getBoundNativeFnName(AS_OBJ(receiver)->type, name->chars);
-    if(tableGet(&vm.globals, key, &value)) {
-      Value bound = OBJ_VAL(newBoundNative(receiver, AS_NATIVE(value), ((ObjNative*)AS_OBJ(value))->callsLox));
-      vm.stackTop[-argCount - 1] = bound;
-      return callValue(bound, argCount);
+    if(tableGet(&vm.nativeMethods[OBJ_TYPE(receiver)], name, &value)) {
+      Value* receiverSlot = vm.stackTop - argCount - 1;
+      flattenNativeArgs(receiverSlot, argCount);
+      Value result = AS_NATIVE(value)(receiverSlot, argCount, vm.stackTop - argCount);
+      if (vm.hadRuntimeError) return false;
+      vm.stackTop -= argCount + 1;
+      push(result);
+      return true;
     }
   }
 
@@ -348,14 +397,27 @@ static bool bindMethod(ObjClass* klass, ObjString* name) {
   return true;
 }
 
+static bool checkIndex(Value index, int length, int* result) {
+  if (!IS_NUMBER(index)) {
+    runtimeError("Index must be a number.");
+    return false;
+  }
+  double number = AS_NUMBER(index);
+  if (!(number >= 0 && number < length)) {
+    runtimeError("Index out of bounds.");
+    return false;
+  }
+  *result = (int)number;
+  return true;
+}
+
 static bool bindNativeFn(Obj* obj, ObjString* name) {
   Value function;
-  ObjString *key = getBoundNativeFnName(obj->type, name->chars);
-  if(!tableGet(&vm.globals, key, &function)) {
+  if(!tableGet(&vm.nativeMethods[obj->type], name, &function)) {
     runtimeError("Undefined property '%s'.", name->chars);
     return false;
   }
-  ObjBoundNative* bound = newBoundNative(peek(0), AS_NATIVE(function), ((ObjNative*)AS_OBJ(function))->callsLox);
+  ObjBoundNative* bound = newBoundNative(peek(0), AS_NATIVE(function));
   pop();
   push(OBJ_VAL(bound));
   return true;
@@ -410,30 +472,48 @@ void mutateConcatenate() {
   ObjBuffer* other = AS_BUFFER(peek(0));
   ObjBuffer* buffer = AS_BUFFER(peek(1));
 
-  buffer->bytes = GROW_ARRAY(uint8_t, buffer->bytes, buffer->size, buffer->size + other->size);
-  memcpy(buffer->bytes + buffer->size, other->bytes, other->size);
-  buffer->size += other->size;
+  int size = buffer->size;
+  int otherSize = other->size;
+  resizeBuffer(buffer, size + otherSize);
+  memcpy(buffer->bytes + size, other->bytes, otherSize);
 
   pop();
 }
 
-void concatenate() {
+// Returns false after reporting a runtime error when the result would be
+// too long for a string
+bool concatenate() {
   ObjString* b = AS_STRING(peek(0));
   ObjString* a = AS_STRING(peek(1));
 
-  int length = a->length + b->length;
-  char* chars = ALLOCATE(char, length + 1);
-  memcpy(chars, a->chars, a->length);
-  memcpy(chars + a->length, b->chars, b->length);
-  chars[length] = '\0';
+  int64_t total = (int64_t)a->length + b->length;
+  if (total > INT_MAX) {
+    runtimeError("String too long.");
+    return false;
+  }
 
-  ObjString* result = takeString(chars, length);
+  ObjString* result;
+  int length = (int)total;
+  if (a->length == 0) {
+    result = b;
+  } else if (b->length == 0) {
+    result = a;
+  } else if (length < ROPE_MIN_LENGTH) {
+    // Both are flat, a rope is never this short
+    result = allocateString(length);
+    memcpy(result->chars, a->chars, a->length);
+    memcpy(result->chars + a->length, b->chars, b->length);
+  } else {
+    result = newRope(a, b);
+  }
   pop();
   pop();
   push(OBJ_VAL(result));
+  return true;
 }
 
-static InterpretResult run() {
+// Executes until the frame above baseFrame returns
+static InterpretResult run(int baseFrame) {
   CallFrame* frame = &vm.frames[vm.frameCount - 1];
 
 #ifdef DEBUG_TRACE_EXECUTION
@@ -481,6 +561,10 @@ static InterpretResult run() {
     &&DO_OP_CLASS,
     &&DO_OP_INHERIT,
     &&DO_OP_METHOD,
+    &&DO_OP_GET_INDEX,
+    &&DO_OP_SET_INDEX,
+    &&DO_OP_ARRAY_LITERAL,
+    &&DO_OP_OBJECT_LITERAL,
   };
 
 #define READ_BYTE() (*frame->ip++)
@@ -651,13 +735,13 @@ static InterpretResult run() {
     DO_OP_LESS:     BINARY_OP(BOOL_VAL, <); DISPATCH();
     DO_OP_ADD: {
       if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
-        concatenate();
+        if (!concatenate()) return INTERPRET_RUNTIME_ERROR;
       } else if(IS_STRING(peek(1)) && IS_NUMBER(peek(0))) {
         double num = AS_NUMBER(pop());
-        char buf[32];
-        snprintf(buf, 32, "%d", (int)num);
-        push(OBJ_VAL(copyString(buf, strlen(buf))));
-        concatenate();
+        char buf[NUMBER_BUFFER_SIZE];
+        int length = formatNumber(num, buf);
+        push(OBJ_VAL(newString(buf, length)));
+        if (!concatenate()) return INTERPRET_RUNTIME_ERROR;
       } else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
         double b = AS_NUMBER(pop());
         double a = AS_NUMBER(pop());
@@ -753,13 +837,11 @@ static InterpretResult run() {
       Value result = pop();
       closeUpvalues(frame->slots);
       vm.frameCount--;
-      if (vm.frameCount == 0) {
-        pop();
-        return INTERPRET_OK;
-      }
-
+      // The result replaces the callee's slot even for the outermost
+      // frame, where vmCall() picks it up
       vm.stackTop = frame->slots;
       push(result);
+      if (vm.frameCount == baseFrame) return INTERPRET_OK;
       frame = &vm.frames[vm.frameCount - 1];
       DISPATCH();
     }
@@ -783,6 +865,114 @@ static InterpretResult run() {
       defineMethod(READ_STRING());
       DISPATCH();
     }
+    DO_OP_GET_INDEX: {
+      Value target = peek(1);
+      Value result;
+      int index;
+      if (IS_ARRAY(target)) {
+        ObjArray* array = AS_ARRAY(target);
+        if (!checkIndex(peek(0), array->values.count, &index)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        result = array->values.values[index];
+      } else if (IS_STRING(target)) {
+        ObjString* string = AS_STRING(target);
+        if (!checkIndex(peek(0), string->length, &index)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        flattenString(string);
+        result = OBJ_VAL(charString((uint8_t)string->chars[index]));
+      } else if (IS_BUFFER(target)) {
+        ObjBuffer* buffer = AS_BUFFER(target);
+        if (!checkIndex(peek(0), buffer->size, &index)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        result = NUMBER_VAL(buffer->bytes[index]);
+      } else if (IS_TYPED_ARRAY(target)) {
+        ObjTypedArray* array = AS_TYPED_ARRAY(target);
+        if (!checkIndex(peek(0), array->length, &index)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        result = NUMBER_VAL(typedArrayElement(array, index));
+      } else {
+        runtimeError("Only arrays, buffers, typed arrays and strings can be indexed.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      vm.stackTop -= 2;
+      push(result);
+      DISPATCH();
+    }
+    DO_OP_SET_INDEX: {
+      Value target = peek(2);
+      Value value = peek(0);
+      int index;
+      if (IS_ARRAY(target)) {
+        ObjArray* array = AS_ARRAY(target);
+        if (!checkIndex(peek(1), array->values.count, &index)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        setArrayElement(array, index, value);
+      } else if (IS_BUFFER(target) || IS_TYPED_ARRAY(target)) {
+        bool isBuffer = IS_BUFFER(target);
+        int length = isBuffer ? AS_BUFFER(target)->size : AS_TYPED_ARRAY(target)->length;
+        if (!checkIndex(peek(1), length, &index)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        if (!IS_NUMBER(value)) {
+          runtimeError("Value must be a number.");
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        if (isBuffer) {
+          if (!isByteValue(AS_NUMBER(value))) {
+            runtimeError("Buffer value must be an integer from 0 to 255.");
+            return INTERPRET_RUNTIME_ERROR;
+          }
+          AS_BUFFER(target)->bytes[index] = (uint8_t)AS_NUMBER(value);
+        } else {
+          setTypedArrayElement(AS_TYPED_ARRAY(target), index, AS_NUMBER(value));
+        }
+      } else if (IS_STRING(target)) {
+        runtimeError("Strings are immutable.");
+        return INTERPRET_RUNTIME_ERROR;
+      } else {
+        runtimeError("Only arrays, buffers and typed arrays can be assigned by index.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      vm.stackTop -= 3;
+      push(value);
+      DISPATCH();
+    }
+    DO_OP_ARRAY_LITERAL: {
+      int count = READ_BYTE();
+      ObjArray* array = newArray();
+      push(OBJ_VAL(array));
+      reserveValueArray(&array->values, count);
+      Value* elements = vm.stackTop - 1 - count;
+      for (int i = 0; i < count; i++) {
+        if (!IS_NUMBER(elements[i])) array->kind = ELEMENTS_VALUES;
+        array->values.values[i] = elements[i];
+      }
+      array->values.count = count;
+      vm.stackTop -= count + 1;
+      push(OBJ_VAL(array));
+      DISPATCH();
+    }
+    DO_OP_OBJECT_LITERAL: {
+      int fieldCount = READ_BYTE();
+      Value* fields = vm.stackTop - fieldCount;
+      if (!IS_CLASS(fields[-1])) {
+        runtimeError("Object literals need the 'Object' class.");
+        return INTERPRET_RUNTIME_ERROR;
+      }
+      ObjInstance* instance = newInstance(AS_CLASS(fields[-1]));
+      fields[-1] = OBJ_VAL(instance);
+      tableReserve(&instance->fields, fieldCount);
+      for (int i = 0; i < fieldCount; i++) {
+        tableSet(&instance->fields, READ_STRING(), fields[i]);
+      }
+      vm.stackTop -= fieldCount;
+      DISPATCH();
+    }
   }
 
 #undef READ_BYTE
@@ -794,8 +984,28 @@ static InterpretResult run() {
 }
 
 InterpretResult interpret(const char* source) {
+  jmp_buf outOfMemory;
+  jmp_buf* enclosingJump = vm.outOfMemoryJump;
+  vm.outOfMemoryJump = &outOfMemory;
+  vm.hadRuntimeError = false;
+  if (setjmp(outOfMemory) != 0) {
+    vm.outOfMemoryJump = enclosingJump;
+    // Don't let the GC walk compilers the jump unwound
+    resetCompiler();
+    if (vm.gcConfig.heapLimit != 0) {
+      runtimeError("Out of memory: heap limit of %zu bytes exceeded.",
+                   vm.gcConfig.heapLimit);
+    } else {
+      runtimeError("Out of memory.");
+    }
+    return INTERPRET_RUNTIME_ERROR;
+  }
+
   ObjFunction* function = compile(source);
-  if (function == NULL) return INTERPRET_COMPILE_ERROR;
+  if (function == NULL) {
+    vm.outOfMemoryJump = enclosingJump;
+    return INTERPRET_COMPILE_ERROR;
+  }
 
   push(OBJ_VAL(function));
   ObjClosure* closure = newClosure(function);
@@ -803,7 +1013,11 @@ InterpretResult interpret(const char* source) {
   push(OBJ_VAL(closure));
   call(closure, 0);
 
-  return run();
+  InterpretResult result = run(0);
+  // Drop the script's own return value
+  if (result == INTERPRET_OK) pop();
+  vm.outOfMemoryJump = enclosingJump;
+  return result;
 }
 
 InterpretResult validate(const char* source) {
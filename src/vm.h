@@ -2,6 +2,7 @@
 #define clox_vm_h
 
 #include <limits.h>
+#include <setjmp.h>
 
 #include "object.h"
 #include "table.h"
@@ -25,24 +26,58 @@ typedef struct {
   Value* slots;
 } CallFrame;
 
+typedef struct {
+  double heapGrowFactor;
+  size_t initialHeapSize;
+  size_t heapLimit; // 0 means unbounded
+  bool lowMemory; // collect eagerly to keep the heap close to its live size
+  bool lazySweep; // free unreached objects during later allocations
+  int markThreads; // 0 picks one per core
+  size_t parallelMarkThreshold; // heap size from which marking goes parallel
+} GCConfig;
+
+#define GC_PAUSE_BUCKETS 8
+
+typedef struct {
+  size_t collections;
+  size_t parallelMarks;
+  size_t allocations;
+  uint64_t totalPauseNs;
+  uint64_t maxPauseNs;
+  uint64_t lastPauseNs;
+  size_t pauseHistogram[GC_PAUSE_BUCKETS];
+  uint64_t lazySweepNs; // time spent sweeping outside of the pauses
+  size_t lastBytesFreed;
+  size_t totalBytesFreed;
+} GCStats;
+
 typedef struct {
   CallFrame frames[FRAMES_MAX];
   int frameCount;
 
   Value stack[STACK_MAX];
   Value* stackTop;
+  bool hadRuntimeError; // set by runtimeError(), cleared by interpret() and vmCall()
   Table globals;
   Table strings;
+  Table nativeMethods[OBJ_TYPE_COUNT]; // bound native methods by receiver type
   ObjString* initString;
+  ObjString* charStrings[256]; // interned one character strings, see charString()
   ObjUpvalue* openUpvalues;
 
   size_t bytesAllocated;
   size_t nextGC;
+  size_t externalBytes; // large object space and memory reported by ObjRefs
+  size_t nextExternalGC;
   size_t debug_maxTotalAllocated;
   Obj* objects;
+  Obj** sweepLink; // lazy sweep cursor into objects, NULL when no sweep is pending
   int grayCount;
   int grayCapacity;
   Obj** grayStack;
+  GCConfig gcConfig;
+  GCStats gcStats;
+  jmp_buf* outOfMemoryJump; // where to unwind to when the heap is exhausted
 
   void *nativeModules[MAX_NATIVE_MODULES];
   int nativeModuleCount;
@@ -66,10 +101,9 @@ InterpretResult validate(const char* source);
 void push(Value value);
 Value pop();
 Value peek(int distance);
-Value callLoxCode(const char* name, Value *receiver, int argCount, Value *args);
+bool vmCall(Value callee, int argCount, Value* args, Value* result);
 void mutateConcatenate();
-void concatenate();
-bool callModule(ObjClosure *closure, int argCount);
+bool concatenate();
 ObjInstance *createObjectInstance();
 
 #endif
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+// Calls into Lox the way an embedder does, after interpret() has returned
+// and with no frame active
+
+static int failures = 0;
+
+static void check(bool condition, const char* message) {
+  if (!condition) {
+    fprintf(stderr, "FAIL: %s\n", message);
+    failures++;
+  }
+}
+
+static Value global(const char* name) {
+  Value value = NIL_VAL;
+  tableGet(&vm.globals, copyString(name, (int)strlen(name)), &value);
+  return value;
+}
+
+int main() {
+  initVM();
+  check(interpret("fun add1(x) { return x + 1; }\n"
+                  "fun fail() { return nil + 1; }\n") == INTERPRET_OK,
+        "script runs");
+
+  Value args[] = {NUMBER_VAL(41)};
+  Value result = NIL_VAL;
+  check(vmCall(global("add1"), 1, args, &result), "closure call succeeds");
+  check(IS_NUMBER(result) && AS_NUMBER(result) == 42,
+        "closure call returns its result");
+  check(vm.stackTop == vm.stack, "closure call leaves the stack empty");
+
+  check(vmCall(global("stringify"), 1, args, &result), "native call succeeds");
+  check(IS_STRING(result) && strcmp(AS_CSTRING(result), "41") == 0,
+        "native call returns its result");
+  check(vm.stackTop == vm.stack, "native call leaves the stack empty");
+
+  fprintf(stderr, "(expected runtime error follows)\n");
+  check(!vmCall(global("fail"), 0, NULL, &result), "runtime error fails");
+  check(vm.frameCount == 0 && vm.stackTop == vm.stack,
+        "runtime error unwinds");
+
+  check(interpret("print add1(1);\n") == INTERPRET_OK, "VM still usable");
+
+  freeVM();
+  return failures == 0 ? 0 : 1;
+}